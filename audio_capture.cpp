@@ -3,6 +3,7 @@
 #include <cstdio>
 #include <cmath>
 #include <algorithm>
+#include <chrono>
 
 #ifndef M_PI
 #define M_PI 3.14159265358979323846
@@ -14,73 +15,43 @@ AudioCapture::AudioCapture(int len_ms) {
 }
 
 AudioCapture::~AudioCapture() {
-    if (m_dev_id_in) {
-        SDL_CloseAudioDevice(m_dev_id_in);
+    // Stop the source before the buffer it writes into goes away
+    if (m_source) {
+        m_source->stop();
+        m_source.reset();
     }
 }
 
 bool AudioCapture::init(int capture_id, int sample_rate) {
-    SDL_LogSetPriority(SDL_LOG_CATEGORY_APPLICATION, SDL_LOG_PRIORITY_INFO);
-
-    if (SDL_Init(SDL_INIT_AUDIO) < 0) {
-        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Couldn't initialize SDL: %s\n", SDL_GetError());
-        return false;
-    }
+    return init(std::unique_ptr<AudioSource>(new SdlAudioSource(capture_id)), sample_rate);
+}
 
-    SDL_SetHintWithPriority(SDL_HINT_AUDIO_RESAMPLING_MODE, "medium", SDL_HINT_OVERRIDE);
+bool AudioCapture::init(std::unique_ptr<AudioSource> source, int sample_rate) {
+    m_source = std::move(source);
 
-    {
-        int nDevices = SDL_GetNumAudioDevices(SDL_TRUE);
-        fprintf(stderr, "%s: found %d capture devices:\n", __func__, nDevices);
-        for (int i = 0; i < nDevices; i++) {
-            fprintf(stderr, "%s:    - Capture device #%d: '%s'\n", __func__, i, SDL_GetAudioDeviceName(i, SDL_TRUE));
-        }
+    if (!m_source->open(sample_rate, [this](const float* samples, size_t n_samples) {
+            callback(samples, n_samples);
+        })) {
+        m_source.reset();
+        return false;
     }
 
-    SDL_AudioSpec capture_spec_requested;
-    SDL_AudioSpec capture_spec_obtained;
-
-    SDL_zero(capture_spec_requested);
-    SDL_zero(capture_spec_obtained);
-
-    capture_spec_requested.freq = sample_rate;
-    capture_spec_requested.format = AUDIO_F32;
-    capture_spec_requested.channels = 1;
-    capture_spec_requested.samples = 1024;
-    capture_spec_requested.callback = [](void* userdata, uint8_t* stream, int len) {
-        AudioCapture* audio = (AudioCapture*)userdata;
-        audio->callback(stream, len);
-    };
-    capture_spec_requested.userdata = this;
-
-    if (capture_id >= 0) {
-        fprintf(stderr, "%s: attempt to open capture device %d : '%s' ...\n", __func__, capture_id, SDL_GetAudioDeviceName(capture_id, SDL_TRUE));
-        m_dev_id_in = SDL_OpenAudioDevice(SDL_GetAudioDeviceName(capture_id, SDL_TRUE), SDL_TRUE, &capture_spec_requested, &capture_spec_obtained, 0);
-    } else {
-        fprintf(stderr, "%s: attempt to open default capture device ...\n", __func__);
-        m_dev_id_in = SDL_OpenAudioDevice(nullptr, SDL_TRUE, &capture_spec_requested, &capture_spec_obtained, 0);
-    }
+    m_sample_rate = m_source->sample_rate();
 
-    if (!m_dev_id_in) {
-        fprintf(stderr, "%s: couldn't open an audio device for capture: %s!\n", __func__, SDL_GetError());
-        m_dev_id_in = 0;
+    // Headroom of one more buffer length keeps get_contiguous() windows
+    // intact while whisper is still reading them
+    const size_t n_samples = (m_sample_rate * m_len_ms) / 1000;
+    if (!m_audio.init(n_samples, n_samples)) {
         return false;
-    } else {
-        fprintf(stderr, "%s: obtained spec for input device (SDL Id = %d):\n", __func__, m_dev_id_in);
-        fprintf(stderr, "%s:     - sample rate:       %d\n", __func__, capture_spec_obtained.freq);
-        fprintf(stderr, "%s:     - format:            %d (required: %d)\n", __func__, capture_spec_obtained.format, capture_spec_requested.format);
-        fprintf(stderr, "%s:     - channels:          %d (required: %d)\n", __func__, capture_spec_obtained.channels, capture_spec_requested.channels);
-        fprintf(stderr, "%s:     - samples per frame: %d\n", __func__, capture_spec_obtained.samples);
     }
-
-    m_sample_rate = capture_spec_obtained.freq;
-    m_audio.resize((m_sample_rate * m_len_ms) / 1000);
+    fprintf(stderr, "%s: capture buffer: %zu samples (%s)\n", __func__, n_samples,
+            m_audio.is_mirrored() ? "mirrored, zero-copy reads" : "copying");
 
     return true;
 }
 
 bool AudioCapture::resume() {
-    if (!m_dev_id_in) {
+    if (!m_source) {
         fprintf(stderr, "%s: no audio device to resume!\n", __func__);
         return false;
     }
@@ -90,14 +61,14 @@ bool AudioCapture::resume() {
         return false;
     }
 
-    SDL_PauseAudioDevice(m_dev_id_in, 0);
     m_running = true;
+    m_source->start();
 
     return true;
 }
 
 bool AudioCapture::pause() {
-    if (!m_dev_id_in) {
+    if (!m_source) {
         fprintf(stderr, "%s: no audio device to pause!\n", __func__);
         return false;
     }
@@ -107,61 +78,65 @@ bool AudioCapture::pause() {
         return false;
     }
 
-    SDL_PauseAudioDevice(m_dev_id_in, 1);
+    m_source->stop();
     m_running = false;
 
     return true;
 }
 
 bool AudioCapture::clear() {
-    if (!m_dev_id_in) {
+    if (!m_source) {
         fprintf(stderr, "%s: no audio device to clear!\n", __func__);
         return false;
     }
 
-    if (!m_running) {
-        fprintf(stderr, "%s: not running!\n", __func__);
-        return false;
-    }
-
+    // Also allowed while paused, so buffered audio can be dropped before
+    // resume() without losing the first frames that arrive after it
     {
         std::lock_guard<std::mutex> lock(m_mutex);
-        m_audio_pos = 0;
-        m_audio_len = 0;
+        m_audio.clear();
     }
 
     return true;
 }
 
-void AudioCapture::callback(uint8_t* stream, int len) {
+void AudioCapture::callback(const float* samples, size_t n_samples) {
     if (!m_running) {
         return;
     }
 
-    size_t n_samples = len / sizeof(float);
-
-    if (n_samples > m_audio.size()) {
-        n_samples = m_audio.size();
-        stream += (len - (n_samples * sizeof(float)));
-    }
-
     {
         std::lock_guard<std::mutex> lock(m_mutex);
-
-        if (m_audio_pos + n_samples > m_audio.size()) {
-            const size_t n0 = m_audio.size() - m_audio_pos;
-            memcpy(&m_audio[m_audio_pos], stream, n0 * sizeof(float));
-            memcpy(&m_audio[0], stream + n0 * sizeof(float), (n_samples - n0) * sizeof(float));
-        } else {
-            memcpy(&m_audio[m_audio_pos], stream, n_samples * sizeof(float));
-        }
-        m_audio_pos = (m_audio_pos + n_samples) % m_audio.size();
-        m_audio_len = std::min(m_audio_len + n_samples, m_audio.size());
+        m_audio.write(samples, n_samples);
+        m_n_captured += n_samples;
     }
+
+    // Wake the processing thread once per frame
+    m_cv.notify_all();
+}
+
+uint64_t AudioCapture::get_since(uint64_t pos, std::vector<float>& result) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    const uint64_t n_new = m_n_captured > pos ? m_n_captured - pos : 0;
+    m_audio.read((size_t)std::min<uint64_t>(n_new, m_audio.size()), result);
+
+    return m_n_captured - result.size();
+}
+
+bool AudioCapture::wait_for_audio(uint64_t& pos, int timeout_ms) {
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    const bool got_audio = m_cv.wait_for(lock, std::chrono::milliseconds(timeout_ms), [&] {
+        return m_n_captured > pos;
+    });
+
+    pos = m_n_captured;
+    return got_audio;
 }
 
 void AudioCapture::get(int ms, std::vector<float>& result) {
-    if (!m_dev_id_in) {
+    if (!m_source) {
         fprintf(stderr, "%s: no audio device to get audio from!\n", __func__);
         return;
     }
@@ -180,26 +155,82 @@ void AudioCapture::get(int ms, std::vector<float>& result) {
             ms = m_len_ms;
         }
 
-        size_t n_samples = (m_sample_rate * ms) / 1000;
-        if (n_samples > m_audio_len) {
-            n_samples = m_audio_len;
-        }
+        m_audio.read((m_sample_rate * ms) / 1000, result);
+    }
+}
 
-        result.resize(n_samples);
+const float* AudioCapture::get_contiguous(int ms, size_t& n_samples, std::vector<float>& scratch) {
+    n_samples = 0;
 
-        int s0 = m_audio_pos - n_samples;
-        if (s0 < 0) {
-            s0 += m_audio.size();
-        }
+    if (!m_source) {
+        fprintf(stderr, "%s: no audio device to get audio from!\n", __func__);
+        return nullptr;
+    }
 
-        if (s0 + n_samples > m_audio.size()) {
-            const size_t n0 = m_audio.size() - s0;
-            memcpy(result.data(), &m_audio[s0], n0 * sizeof(float));
-            memcpy(&result[n0], &m_audio[0], (n_samples - n0) * sizeof(float));
-        } else {
-            memcpy(result.data(), &m_audio[s0], n_samples * sizeof(float));
-        }
+    if (!m_running) {
+        fprintf(stderr, "%s: not running!\n", __func__);
+        return nullptr;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (ms <= 0) {
+        ms = m_len_ms;
+    }
+
+    const size_t n_wanted = (m_sample_rate * ms) / 1000;
+
+    const float* data = m_audio.window(n_wanted);
+    if (data) {
+        n_samples = std::min(n_wanted, m_audio.size());
+    } else {
+        m_audio.read(n_wanted, scratch);
+        n_samples = scratch.size();
+        data = scratch.data();
+    }
+
+    return n_samples > 0 ? data : nullptr;
+}
+
+const float* AudioCapture::get_range(uint64_t begin, uint64_t end, size_t& n_samples, std::vector<float>& scratch) {
+    n_samples = 0;
+
+    if (!m_source) {
+        fprintf(stderr, "%s: no audio device to get audio from!\n", __func__);
+        return nullptr;
+    }
+
+    if (!m_running) {
+        fprintf(stderr, "%s: not running!\n", __func__);
+        return nullptr;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    const uint64_t oldest = m_n_captured - m_audio.size();
+    begin = std::max(begin, oldest);
+    end = std::min(end, m_n_captured);
+    if (begin >= end) {
+        return nullptr;
+    }
+
+    // Everything from begin to the newest sample, then cut off the end
+    const size_t n_back = (size_t)(m_n_captured - begin);
+
+    const float* data = m_audio.window(n_back);
+    if (!data) {
+        m_audio.read(n_back, scratch);
+        data = scratch.data();
+    }
+    n_samples = (size_t)(end - begin);
+
+    // Keep a copy to exactly the range, so callers that use scratch itself
+    // (e.g. padding it in place) never pick up audio past end
+    if (data == scratch.data()) {
+        scratch.resize(n_samples);
     }
+
+    return data;
 }
 
 // High-pass filter implementation
@@ -1,45 +1,75 @@
 #pragma once
 
-#include <SDL.h>
-#include <SDL_audio.h>
-
 #include <atomic>
 #include <cstdint>
+#include <memory>
 #include <vector>
 #include <mutex>
+#include <condition_variable>
+
+#include "audio_ring_buffer.h"
+#include "audio_source.h"
 
-// Audio capture class for microphone input
+// Audio capture class for microphone (or other source) input
 // Adapted from whisper.cpp common-sdl
 class AudioCapture {
 public:
     AudioCapture(int len_ms);
     ~AudioCapture();
 
+    // Open the SDL capture device
     bool init(int capture_id, int sample_rate);
+
+    // Capture from any audio source (file replay, generator, ...)
+    bool init(std::unique_ptr<AudioSource> source, int sample_rate);
+
     bool resume();
     bool pause();
-    bool clear();
+    bool clear();  // also while paused
 
-    // SDL callback
-    void callback(uint8_t* stream, int len);
+    // Source callback
+    void callback(const float* samples, size_t n_samples);
 
     // Get audio data from circular buffer
     void get(int ms, std::vector<float>& audio);
 
+    // Get the last ms of audio as one contiguous block. Zero-copy when the
+    // ring buffer is mirrored (pointer valid for roughly another len_ms of
+    // capture); otherwise copies into scratch. Returns nullptr if no audio.
+    const float* get_contiguous(int ms, size_t& n_samples, std::vector<float>& scratch);
+
+    // Get the audio between sample positions begin and end as one block,
+    // clamped to what is still buffered. Zero-copy like get_contiguous();
+    // when copied, scratch holds exactly n_samples.
+    // Returns nullptr if none of the range is buffered.
+    const float* get_range(uint64_t begin, uint64_t end, size_t& n_samples, std::vector<float>& scratch);
+
+    // Copy the audio captured after sample position pos, clamped to what is
+    // still buffered. Returns the sample position of result[0].
+    uint64_t get_since(uint64_t pos, std::vector<float>& result);
+
+    // Block until the callback delivers audio past `pos` (total samples
+    // captured so far) or timeout_ms elapses. Updates pos, returns true if
+    // new audio arrived.
+    bool wait_for_audio(uint64_t& pos, int timeout_ms);
+
+    // True once a finite source (e.g. a WAV file) has delivered everything
+    bool finished() const { return m_source && m_source->finished(); }
+
     int getSampleRate() const { return m_sample_rate; }
 
 private:
-    SDL_AudioDeviceID m_dev_id_in = 0;
+    std::unique_ptr<AudioSource> m_source;
 
     int m_len_ms = 0;
     int m_sample_rate = 0;
 
     std::atomic_bool m_running;
     std::mutex m_mutex;
+    std::condition_variable m_cv;
 
-    std::vector<float> m_audio;
-    size_t m_audio_pos = 0;
-    size_t m_audio_len = 0;
+    AudioRingBuffer m_audio;
+    uint64_t m_n_captured = 0;  // monotonic sample clock, not reset by clear()
 };
 
 // Voice Activity Detection using energy-based threshold
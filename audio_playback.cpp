@@ -15,6 +15,12 @@ AudioPlayback::~AudioPlayback() {
 bool AudioPlayback::init(int sample_rate) {
     m_sample_rate = sample_rate;
 
+    // Capture may not be using SDL (file or generated input)
+    if (SDL_Init(SDL_INIT_AUDIO) < 0) {
+        fprintf(stderr, "%s: couldn't initialize SDL: %s\n", __func__, SDL_GetError());
+        return false;
+    }
+
     SDL_AudioSpec spec_requested;
     SDL_AudioSpec spec_obtained;
 
@@ -82,6 +88,8 @@ void AudioPlayback::waitComplete() {
     m_buffer.clear();
     m_read_pos = 0;
     m_playing = false;
+
+    resetOutputStart();
 }
 
 bool AudioPlayback::isPlaying() const {
@@ -98,6 +106,8 @@ void AudioPlayback::clear() {
     m_read_pos = 0;
     m_playing = false;
     m_cv.notify_all();
+
+    resetOutputStart();
 }
 
 void AudioPlayback::audioCallback(void* userdata, uint8_t* stream, int len) {
@@ -115,6 +125,7 @@ void AudioPlayback::fillBuffer(uint8_t* stream, int len) {
     if (samples_to_copy > 0) {
         memcpy(stream, m_buffer.data() + m_read_pos, samples_to_copy * sizeof(float));
         m_read_pos += samples_to_copy;
+        markOutputStart();
     }
 
     // Fill remaining with silence
@@ -8,26 +8,28 @@
 #include <mutex>
 #include <condition_variable>
 
-// Audio playback class for speaker output
-class AudioPlayback {
+#include "audio_sink.h"
+
+// Audio playback class for speaker output (SDL device sink)
+class AudioPlayback : public AudioSink {
 public:
     AudioPlayback();
-    ~AudioPlayback();
+    ~AudioPlayback() override;
 
-    bool init(int sample_rate);
-    void close();
+    bool init(int sample_rate) override;
+    void close() override;
 
     // Queue audio samples for playback
-    void queue(const float* samples, size_t num_samples);
+    void queue(const float* samples, size_t num_samples) override;
 
     // Wait for all queued audio to finish playing
-    void waitComplete();
+    void waitComplete() override;
 
     // Check if audio is currently playing
-    bool isPlaying() const;
+    bool isPlaying() const override;
 
     // Clear any queued audio
-    void clear();
+    void clear() override;
 
 private:
     // SDL callback
@@ -0,0 +1,159 @@
+#include "audio_ring_buffer.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+AudioRingBuffer::~AudioRingBuffer() {
+    release();
+}
+
+void AudioRingBuffer::release() {
+#if defined(__linux__)
+    if (m_mirrored && m_data) {
+        munmap(m_data, 2 * m_map_bytes);
+    }
+#endif
+    m_data = nullptr;
+    m_capacity = 0;
+    m_map_bytes = 0;
+    m_max_len = 0;
+    m_pos = 0;
+    m_len = 0;
+    m_mirrored = false;
+    m_fallback.clear();
+    m_fallback.shrink_to_fit();
+}
+
+bool AudioRingBuffer::init(size_t n_samples, size_t n_headroom) {
+    release();
+
+    if (n_samples == 0) {
+        fprintf(stderr, "%s: buffer size must be > 0\n", __func__);
+        return false;
+    }
+
+    if (init_mirrored(n_samples + n_headroom)) {
+        m_max_len = n_samples;
+        return true;
+    }
+
+    // Portable fallback: single copy, reads across the seam are copied
+    m_fallback.assign(n_samples, 0.0f);
+    m_data = m_fallback.data();
+    m_capacity = n_samples;
+    m_max_len = n_samples;
+
+    return true;
+}
+
+bool AudioRingBuffer::init_mirrored(size_t n_samples) {
+#if defined(__linux__) && defined(MFD_CLOEXEC)
+    const size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    const size_t bytes = ((n_samples * sizeof(float) + page - 1) / page) * page;
+
+    int fd = memfd_create("audio_ring", MFD_CLOEXEC);
+    if (fd < 0) {
+        fprintf(stderr, "%s: memfd_create failed, using copying ring buffer\n", __func__);
+        return false;
+    }
+
+    if (ftruncate(fd, (off_t)bytes) != 0) {
+        fprintf(stderr, "%s: ftruncate failed, using copying ring buffer\n", __func__);
+        close(fd);
+        return false;
+    }
+
+    // Reserve 2x the address space, then map the same pages into both halves
+    uint8_t* base = (uint8_t*)mmap(nullptr, 2 * bytes, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED) {
+        close(fd);
+        return false;
+    }
+
+    void* lo = mmap(base, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0);
+    void* hi = mmap(base + bytes, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0);
+    close(fd);
+
+    if (lo == MAP_FAILED || hi == MAP_FAILED) {
+        fprintf(stderr, "%s: mirrored mmap failed, using copying ring buffer\n", __func__);
+        munmap(base, 2 * bytes);
+        return false;
+    }
+
+    m_data = (float*)base;
+    m_capacity = bytes / sizeof(float);
+    m_map_bytes = bytes;
+    m_mirrored = true;
+
+    return true;
+#else
+    (void)n_samples;
+    return false;
+#endif
+}
+
+void AudioRingBuffer::write(const float* samples, size_t n_samples) {
+    if (!m_data) {
+        return;
+    }
+
+    // Only the most recent samples can be kept
+    if (n_samples > m_max_len) {
+        samples += n_samples - m_max_len;
+        n_samples = m_max_len;
+    }
+
+    if (m_mirrored) {
+        // Writes past the end land in the mirror, i.e. at the start
+        memcpy(m_data + m_pos, samples, n_samples * sizeof(float));
+    } else if (m_pos + n_samples > m_capacity) {
+        const size_t n0 = m_capacity - m_pos;
+        memcpy(m_data + m_pos, samples, n0 * sizeof(float));
+        memcpy(m_data, samples + n0, (n_samples - n0) * sizeof(float));
+    } else {
+        memcpy(m_data + m_pos, samples, n_samples * sizeof(float));
+    }
+
+    m_pos = (m_pos + n_samples) % m_capacity;
+    m_len = std::min(m_len + n_samples, m_max_len);
+}
+
+void AudioRingBuffer::clear() {
+    m_pos = 0;
+    m_len = 0;
+}
+
+void AudioRingBuffer::read(size_t n_samples, std::vector<float>& result) const {
+    n_samples = std::min(n_samples, m_len);
+    result.resize(n_samples);
+
+    if (n_samples == 0) {
+        return;
+    }
+
+    const size_t s0 = (m_pos + m_capacity - n_samples) % m_capacity;
+
+    if (!m_mirrored && s0 + n_samples > m_capacity) {
+        const size_t n0 = m_capacity - s0;
+        memcpy(result.data(), m_data + s0, n0 * sizeof(float));
+        memcpy(result.data() + n0, m_data, (n_samples - n0) * sizeof(float));
+    } else {
+        memcpy(result.data(), m_data + s0, n_samples * sizeof(float));
+    }
+}
+
+const float* AudioRingBuffer::window(size_t n_samples) const {
+    if (!m_mirrored) {
+        return nullptr;
+    }
+
+    n_samples = std::min(n_samples, m_len);
+    return m_data + (m_pos + m_capacity - n_samples) % m_capacity;
+}
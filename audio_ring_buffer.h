@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+// Circular sample buffer backing AudioCapture.
+//
+// On Linux the storage is a memfd mapped twice back-to-back, so any window of
+// the most recent samples is a single contiguous block and can be handed to
+// whisper_full without a wraparound copy. Elsewhere (or if mapping fails) a
+// plain vector is used and window() returns nullptr.
+//
+// Not thread-safe: the owner serializes write/read/clear.
+class AudioRingBuffer {
+public:
+    AudioRingBuffer() = default;
+    ~AudioRingBuffer();
+
+    AudioRingBuffer(const AudioRingBuffer&) = delete;
+    AudioRingBuffer& operator=(const AudioRingBuffer&) = delete;
+
+    // Keep up to n_samples of history. When mirrored, n_headroom extra samples
+    // are reserved so a window() pointer stays valid until that many more
+    // samples have been written.
+    bool init(size_t n_samples, size_t n_headroom = 0);
+
+    void write(const float* samples, size_t n_samples);
+    void clear();
+
+    // Copy the last n_samples (clamped to size()) into result
+    void read(size_t n_samples, std::vector<float>& result) const;
+
+    // Pointer to the last n_samples (clamped to size()) as one contiguous
+    // block, or nullptr when the buffer is not mirrored
+    const float* window(size_t n_samples) const;
+
+    size_t size() const { return m_len; }
+    size_t max_size() const { return m_max_len; }
+    bool is_mirrored() const { return m_mirrored; }
+
+private:
+    bool init_mirrored(size_t n_samples);
+    void release();
+
+    float* m_data = nullptr;
+    size_t m_capacity = 0;     // samples in one copy of the storage
+    size_t m_map_bytes = 0;    // bytes in one mapping (mirrored only)
+    size_t m_max_len = 0;      // history kept for readers
+    size_t m_pos = 0;          // next write position
+    size_t m_len = 0;          // valid samples
+    bool m_mirrored = false;
+
+    std::vector<float> m_fallback;
+};
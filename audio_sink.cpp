@@ -0,0 +1,177 @@
+#include "audio_sink.h"
+
+#include <cstdio>
+#include <algorithm>
+
+// ============================================
+// AudioSink
+// ============================================
+
+AudioSink::Clock::time_point AudioSink::outputStartTime() const {
+    std::lock_guard<std::mutex> lock(m_time_mutex);
+    return m_output_start;
+}
+
+void AudioSink::markOutputStart() {
+    std::lock_guard<std::mutex> lock(m_time_mutex);
+    if (!m_output_started) {
+        m_output_started = true;
+        m_output_start = Clock::now();
+    }
+}
+
+void AudioSink::resetOutputStart() {
+    std::lock_guard<std::mutex> lock(m_time_mutex);
+    m_output_started = false;
+}
+
+// ============================================
+// NullAudioSink
+// ============================================
+
+NullAudioSink::NullAudioSink(bool realtime) : m_realtime(realtime) {
+}
+
+bool NullAudioSink::init(int sample_rate) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_sample_rate = sample_rate;
+    m_play_end = Clock::now();
+    m_samples_total = 0;
+    return true;
+}
+
+void NullAudioSink::queue(const float* samples, size_t num_samples) {
+    (void)samples;
+
+    markOutputStart();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    // Audio queued while idle starts playing now, otherwise after what is queued
+    const auto start = std::max(Clock::now(), m_play_end);
+    const auto duration = std::chrono::duration<double>((double)num_samples / m_sample_rate);
+    m_play_end = start + std::chrono::duration_cast<Clock::duration>(duration);
+    m_samples_total += num_samples;
+}
+
+void NullAudioSink::waitComplete() {
+    if (m_realtime) {
+        // Re-check after each wakeup: more audio or clear() may move the end
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (Clock::now() < m_play_end) {
+            m_cv.wait_until(lock, m_play_end);
+        }
+    }
+
+    resetOutputStart();
+}
+
+bool NullAudioSink::isPlaying() const {
+    if (!m_realtime) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return Clock::now() < m_play_end;
+}
+
+void NullAudioSink::clear() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_play_end = Clock::now();
+    }
+    m_cv.notify_all();
+
+    resetOutputStart();
+}
+
+double NullAudioSink::queuedSeconds() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_sample_rate > 0 ? (double)m_samples_total / m_sample_rate : 0.0;
+}
+
+// ============================================
+// WavFileAudioSink
+// ============================================
+
+WavFileAudioSink::WavFileAudioSink(const std::string& path, bool realtime)
+    : NullAudioSink(realtime), m_path(path) {
+}
+
+WavFileAudioSink::~WavFileAudioSink() {
+    close();
+}
+
+bool WavFileAudioSink::init(int sample_rate) {
+    {
+        std::lock_guard<std::mutex> lock(m_write_mutex);
+        if (!m_writer.open(m_path, sample_rate)) {
+            return false;
+        }
+    }
+
+    fprintf(stderr, "%s: writing playback to '%s' (%d Hz)\n", __func__, m_path.c_str(), sample_rate);
+
+    return NullAudioSink::init(sample_rate);
+}
+
+void WavFileAudioSink::close() {
+    std::lock_guard<std::mutex> lock(m_write_mutex);
+    m_writer.close();
+}
+
+void WavFileAudioSink::queue(const float* samples, size_t num_samples) {
+    {
+        std::lock_guard<std::mutex> lock(m_write_mutex);
+        m_writer.write(samples, num_samples);
+    }
+
+    NullAudioSink::queue(samples, num_samples);
+}
+
+// ============================================
+// CallbackAudioSink
+// ============================================
+
+CallbackAudioSink::CallbackAudioSink(Callback callback, bool wait_for_host)
+    : m_callback(std::move(callback)), m_wait_for_host(wait_for_host) {
+    m_playing = false;
+}
+
+bool CallbackAudioSink::init(int sample_rate) {
+    m_sample_rate = sample_rate;
+    return (bool)m_callback;
+}
+
+void CallbackAudioSink::queue(const float* samples, size_t num_samples) {
+    markOutputStart();
+    m_playing = true;
+    m_callback(samples, num_samples, m_sample_rate);
+}
+
+void CallbackAudioSink::waitComplete() {
+    if (m_wait_for_host) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_cv.wait(lock, [this] { return !m_playing; });
+    }
+
+    m_playing = false;
+    resetOutputStart();
+}
+
+bool CallbackAudioSink::isPlaying() const {
+    return m_playing;
+}
+
+void CallbackAudioSink::clear() {
+    markComplete();
+    resetOutputStart();
+}
+
+void CallbackAudioSink::markComplete() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_playing = false;
+    }
+    m_cv.notify_all();
+}
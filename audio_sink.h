@@ -0,0 +1,122 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+
+#include "wav_file.h"
+
+// Where synthesized speech goes: an SDL device (AudioPlayback), a WAV file,
+// nowhere (timing only), or a host application such as a game engine.
+class AudioSink {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    virtual ~AudioSink() = default;
+
+    virtual bool init(int sample_rate) = 0;
+    virtual void close() {}
+
+    // Queue audio samples for playback
+    virtual void queue(const float* samples, size_t num_samples) = 0;
+
+    // Wait for all queued audio to finish playing
+    virtual void waitComplete() = 0;
+
+    // Check if audio is currently playing
+    virtual bool isPlaying() const = 0;
+
+    // Clear any queued audio
+    virtual void clear() = 0;
+
+    // When the first sample of the current (or most recent) response
+    // reached the output. Used to measure synthesis-to-output latency.
+    Clock::time_point outputStartTime() const;
+
+protected:
+    // Record the output start if nothing was playing before
+    void markOutputStart();
+    // Next markOutputStart() begins a new response
+    void resetOutputStart();
+
+private:
+    mutable std::mutex m_time_mutex;
+    bool m_output_started = false;
+    Clock::time_point m_output_start;
+};
+
+// Discards audio but keeps a real-time playback clock, so waitComplete()
+// returns when the audio would have finished on a real device.
+// With realtime = false it never waits.
+class NullAudioSink : public AudioSink {
+public:
+    explicit NullAudioSink(bool realtime = true);
+
+    bool init(int sample_rate) override;
+    void queue(const float* samples, size_t num_samples) override;
+    void waitComplete() override;
+    bool isPlaying() const override;
+    void clear() override;
+
+    // Total audio accepted since init
+    double queuedSeconds() const;
+
+protected:
+    int m_sample_rate = 0;
+
+private:
+    bool m_realtime;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_cv;
+    Clock::time_point m_play_end;
+    uint64_t m_samples_total = 0;
+};
+
+// Appends everything queued to a 32-bit float WAV file.
+// Timing follows NullAudioSink (not real time by default).
+class WavFileAudioSink : public NullAudioSink {
+public:
+    explicit WavFileAudioSink(const std::string& path, bool realtime = false);
+    ~WavFileAudioSink() override;
+
+    bool init(int sample_rate) override;
+    void close() override;
+    void queue(const float* samples, size_t num_samples) override;
+
+private:
+    std::string m_path;
+    std::mutex m_write_mutex;
+    WavWriter m_writer;
+};
+
+// Hands audio to the host application (e.g. a game engine's audio mixer).
+// If wait_for_host is set, waitComplete() blocks until the host calls
+// markComplete(); otherwise it returns immediately.
+class CallbackAudioSink : public AudioSink {
+public:
+    using Callback = std::function<void(const float* samples, size_t num_samples, int sample_rate)>;
+
+    explicit CallbackAudioSink(Callback callback, bool wait_for_host = false);
+
+    bool init(int sample_rate) override;
+    void queue(const float* samples, size_t num_samples) override;
+    void waitComplete() override;
+    bool isPlaying() const override;
+    void clear() override;
+
+    // Called by the host when everything it was given has been played
+    void markComplete();
+
+private:
+    Callback m_callback;
+    bool m_wait_for_host;
+    int m_sample_rate = 0;
+
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::atomic_bool m_playing;
+};
@@ -0,0 +1,244 @@
+#include "audio_source.h"
+#include "wav_file.h"
+
+#include <cstdio>
+#include <chrono>
+
+// ============================================
+// SdlAudioSource
+// ============================================
+
+SdlAudioSource::SdlAudioSource(int capture_id) : m_capture_id(capture_id) {
+}
+
+SdlAudioSource::~SdlAudioSource() {
+    if (m_dev_id_in) {
+        SDL_CloseAudioDevice(m_dev_id_in);
+    }
+}
+
+bool SdlAudioSource::open(int sample_rate, AudioSourceCallback callback) {
+    m_callback = std::move(callback);
+
+    SDL_LogSetPriority(SDL_LOG_CATEGORY_APPLICATION, SDL_LOG_PRIORITY_INFO);
+
+    if (SDL_Init(SDL_INIT_AUDIO) < 0) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Couldn't initialize SDL: %s\n", SDL_GetError());
+        return false;
+    }
+
+    SDL_SetHintWithPriority(SDL_HINT_AUDIO_RESAMPLING_MODE, "medium", SDL_HINT_OVERRIDE);
+
+    {
+        int nDevices = SDL_GetNumAudioDevices(SDL_TRUE);
+        fprintf(stderr, "%s: found %d capture devices:\n", __func__, nDevices);
+        for (int i = 0; i < nDevices; i++) {
+            fprintf(stderr, "%s:    - Capture device #%d: '%s'\n", __func__, i, SDL_GetAudioDeviceName(i, SDL_TRUE));
+        }
+    }
+
+    SDL_AudioSpec capture_spec_requested;
+    SDL_AudioSpec capture_spec_obtained;
+
+    SDL_zero(capture_spec_requested);
+    SDL_zero(capture_spec_obtained);
+
+    capture_spec_requested.freq = sample_rate;
+    capture_spec_requested.format = AUDIO_F32;
+    capture_spec_requested.channels = 1;
+    capture_spec_requested.samples = 1024;
+    capture_spec_requested.callback = [](void* userdata, uint8_t* stream, int len) {
+        SdlAudioSource* source = (SdlAudioSource*)userdata;
+        source->m_callback((const float*)stream, len / sizeof(float));
+    };
+    capture_spec_requested.userdata = this;
+
+    if (m_capture_id >= 0) {
+        fprintf(stderr, "%s: attempt to open capture device %d : '%s' ...\n", __func__, m_capture_id, SDL_GetAudioDeviceName(m_capture_id, SDL_TRUE));
+        m_dev_id_in = SDL_OpenAudioDevice(SDL_GetAudioDeviceName(m_capture_id, SDL_TRUE), SDL_TRUE, &capture_spec_requested, &capture_spec_obtained, 0);
+    } else {
+        fprintf(stderr, "%s: attempt to open default capture device ...\n", __func__);
+        m_dev_id_in = SDL_OpenAudioDevice(nullptr, SDL_TRUE, &capture_spec_requested, &capture_spec_obtained, 0);
+    }
+
+    if (!m_dev_id_in) {
+        fprintf(stderr, "%s: couldn't open an audio device for capture: %s!\n", __func__, SDL_GetError());
+        m_dev_id_in = 0;
+        return false;
+    } else {
+        fprintf(stderr, "%s: obtained spec for input device (SDL Id = %d):\n", __func__, m_dev_id_in);
+        fprintf(stderr, "%s:     - sample rate:       %d\n", __func__, capture_spec_obtained.freq);
+        fprintf(stderr, "%s:     - format:            %d (required: %d)\n", __func__, capture_spec_obtained.format, capture_spec_requested.format);
+        fprintf(stderr, "%s:     - channels:          %d (required: %d)\n", __func__, capture_spec_obtained.channels, capture_spec_requested.channels);
+        fprintf(stderr, "%s:     - samples per frame: %d\n", __func__, capture_spec_obtained.samples);
+    }
+
+    m_sample_rate = capture_spec_obtained.freq;
+
+    return true;
+}
+
+bool SdlAudioSource::start() {
+    if (!m_dev_id_in) {
+        return false;
+    }
+
+    SDL_PauseAudioDevice(m_dev_id_in, 0);
+    return true;
+}
+
+bool SdlAudioSource::stop() {
+    if (!m_dev_id_in) {
+        return false;
+    }
+
+    SDL_PauseAudioDevice(m_dev_id_in, 1);
+    return true;
+}
+
+// ============================================
+// GeneratorAudioSource
+// ============================================
+
+GeneratorAudioSource::GeneratorAudioSource(AudioGenerator generator, int sample_rate, float speed, int frame_samples)
+    : GeneratorAudioSource(sample_rate, speed, frame_samples) {
+    m_generator = std::move(generator);
+}
+
+GeneratorAudioSource::GeneratorAudioSource(int sample_rate, float speed, int frame_samples)
+    : m_sample_rate(sample_rate), m_speed(speed > 0.0f ? speed : 1.0f), m_frame_samples(frame_samples) {
+    m_finished = false;
+}
+
+GeneratorAudioSource::~GeneratorAudioSource() {
+    shutdown();
+}
+
+void GeneratorAudioSource::shutdown() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_quit = true;
+    }
+    m_cv.notify_all();
+
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+}
+
+bool GeneratorAudioSource::open(int sample_rate, AudioSourceCallback callback) {
+    if (!m_generator) {
+        fprintf(stderr, "%s: no generator\n", __func__);
+        return false;
+    }
+
+    if (sample_rate != m_sample_rate) {
+        fprintf(stderr, "%s: generator produces %d Hz, %d Hz requested\n", __func__, m_sample_rate, sample_rate);
+    }
+
+    m_callback = std::move(callback);
+    m_thread = std::thread(&GeneratorAudioSource::run, this);
+
+    return true;
+}
+
+bool GeneratorAudioSource::start() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_running = true;
+    }
+    m_cv.notify_all();
+    return true;
+}
+
+bool GeneratorAudioSource::stop() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_running = false;
+    return true;
+}
+
+void GeneratorAudioSource::run() {
+    using clock = std::chrono::steady_clock;
+
+    std::vector<float> frame(m_frame_samples);
+
+    while (true) {
+        // Wait until started; pacing restarts from here after every pause
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_cv.wait(lock, [this] { return m_running || m_quit; });
+            if (m_quit) {
+                return;
+            }
+        }
+
+        const auto t_start = clock::now();
+        const uint64_t pos_start = m_pos;
+
+        while (true) {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                if (!m_running || m_quit) {
+                    break;
+                }
+            }
+
+            const size_t n = m_generator(frame.data(), m_frame_samples, m_pos);
+            if (n > 0) {
+                m_callback(frame.data(), n);
+                m_pos += n;
+            }
+
+            if (n < m_frame_samples) {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_running = false;
+                m_finished = true;
+                break;
+            }
+
+            // Sleep until this frame would have been captured in (scaled) real time
+            const double t_audio = (double)(m_pos - pos_start) / m_sample_rate / m_speed;
+            std::this_thread::sleep_until(t_start + std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(t_audio)));
+        }
+    }
+}
+
+// ============================================
+// WavFileAudioSource
+// ============================================
+
+WavFileAudioSource::WavFileAudioSource(const std::string& path, float speed, int tail_silence_ms)
+    : GeneratorAudioSource(0, speed, 1024), m_path(path), m_tail_silence_ms(tail_silence_ms) {
+}
+
+WavFileAudioSource::~WavFileAudioSource() {
+    // The generator reads m_samples, stop it before they go away
+    shutdown();
+}
+
+bool WavFileAudioSource::open(int sample_rate, AudioSourceCallback callback) {
+    std::vector<float> samples;
+    int file_rate = 0;
+
+    if (!read_wav(m_path, samples, file_rate)) {
+        return false;
+    }
+
+    resample_linear(samples, file_rate, m_samples, sample_rate);
+    m_sample_rate = sample_rate;
+
+    fprintf(stderr, "%s: '%s': %.2f s at %d Hz (resampled to %d Hz)\n", __func__, m_path.c_str(),
+            (float)samples.size() / file_rate, file_rate, sample_rate);
+
+    const uint64_t n_total = m_samples.size() + (uint64_t)m_tail_silence_ms * sample_rate / 1000;
+
+    m_generator = [this, n_total](float* frame, size_t n_samples, uint64_t pos) -> size_t {
+        size_t n = 0;
+        for (; n < n_samples && pos + n < n_total; n++) {
+            frame[n] = pos + n < m_samples.size() ? m_samples[pos + n] : 0.0f;
+        }
+        return n;
+    };
+
+    return GeneratorAudioSource::open(sample_rate, std::move(callback));
+}
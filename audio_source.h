@@ -0,0 +1,114 @@
+#pragma once
+
+#include <SDL.h>
+#include <SDL_audio.h>
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Receives mono float frames, called from the source's own thread
+using AudioSourceCallback = std::function<void(const float* samples, size_t n_samples)>;
+
+// Where captured audio comes from: a microphone, a file, or generated data.
+// AudioCapture buffers whatever the source delivers.
+class AudioSource {
+public:
+    virtual ~AudioSource() = default;
+
+    // Prepare the source. sample_rate is the rate requested by the consumer;
+    // sources convert to it where possible, sample_rate() reports the result.
+    virtual bool open(int sample_rate, AudioSourceCallback callback) = 0;
+
+    virtual bool start() = 0;
+    virtual bool stop() = 0;
+
+    virtual int sample_rate() const = 0;
+
+    // True once a finite source has delivered all of its audio
+    virtual bool finished() const { return false; }
+};
+
+// SDL capture device (microphone)
+// Adapted from whisper.cpp common-sdl
+class SdlAudioSource : public AudioSource {
+public:
+    explicit SdlAudioSource(int capture_id = -1);
+    ~SdlAudioSource() override;
+
+    bool open(int sample_rate, AudioSourceCallback callback) override;
+    bool start() override;
+    bool stop() override;
+
+    int sample_rate() const override { return m_sample_rate; }
+
+private:
+    int m_capture_id;
+    int m_sample_rate = 0;
+    SDL_AudioDeviceID m_dev_id_in = 0;
+    AudioSourceCallback m_callback;
+};
+
+// Fills frames from a function on a background thread, paced at `speed`
+// times real time. The generator returns the number of samples written
+// (less than requested ends the stream). Useful for synthetic load.
+using AudioGenerator = std::function<size_t(float* frame, size_t n_samples, uint64_t pos)>;
+
+class GeneratorAudioSource : public AudioSource {
+public:
+    GeneratorAudioSource(AudioGenerator generator, int sample_rate, float speed = 1.0f, int frame_samples = 1024);
+    ~GeneratorAudioSource() override;
+
+    bool open(int sample_rate, AudioSourceCallback callback) override;
+    bool start() override;
+    bool stop() override;
+
+    int sample_rate() const override { return m_sample_rate; }
+    bool finished() const override { return m_finished; }
+
+protected:
+    // For subclasses that only know their generator once opened
+    GeneratorAudioSource(int sample_rate, float speed, int frame_samples);
+
+    // Join the pacing thread (safe to call more than once)
+    void shutdown();
+
+    AudioGenerator m_generator;
+    int m_sample_rate;
+
+private:
+    void run();
+
+    float m_speed;
+    size_t m_frame_samples;
+    AudioSourceCallback m_callback;
+
+    std::thread m_thread;
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    bool m_running = false;
+    bool m_quit = false;
+    std::atomic_bool m_finished;
+    uint64_t m_pos = 0;
+};
+
+// Replays a WAV file (resampled to the requested rate) at `speed` times
+// real time, followed by tail_silence_ms of silence so the last utterance
+// can be endpointed.
+class WavFileAudioSource : public GeneratorAudioSource {
+public:
+    WavFileAudioSource(const std::string& path, float speed = 1.0f, int tail_silence_ms = 2000);
+    ~WavFileAudioSource() override;
+
+    bool open(int sample_rate, AudioSourceCallback callback) override;
+
+private:
+    std::string m_path;
+    int m_tail_silence_ms;
+    std::vector<float> m_samples;
+};
@@ -0,0 +1,137 @@
+#include "endpointer.h"
+
+#include <cmath>
+#include <algorithm>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+Endpointer::Endpointer(int sample_rate, const EndpointerParams& params)
+    : m_sample_rate(sample_rate), m_params(params) {
+    m_frame_samples = std::max<size_t>(1, (size_t)m_sample_rate * m_params.frame_ms / 1000);
+    m_pending.reserve(m_frame_samples);
+
+    const float rc = 1.0f / (2.0f * M_PI * std::max(m_params.freq_thold, 1.0f));
+    const float dt = 1.0f / m_sample_rate;
+    m_hp_alpha = m_params.freq_thold > 0.0f ? rc / (rc + dt) : 1.0f;
+
+    m_floor_db = m_params.min_floor_db;
+}
+
+void Endpointer::reset() {
+    m_in_speech = false;
+    m_sentence_end = false;
+    m_candidate_frames = 0;
+}
+
+EndpointEvent Endpointer::process(uint64_t pos, const float* samples, size_t n_samples) {
+    if (pos != m_next_pos) {
+        // Audio was dropped or cleared upstream: start a fresh frame
+        m_pending.clear();
+        m_pos = pos;
+    }
+    m_next_pos = pos + n_samples;
+
+    EndpointEvent result = EndpointEvent::None;
+
+    size_t i = 0;
+    while (i < n_samples) {
+        const size_t n = std::min(m_frame_samples - m_pending.size(), n_samples - i);
+        m_pending.insert(m_pending.end(), samples + i, samples + i + n);
+        i += n;
+
+        if (m_pending.size() < m_frame_samples) {
+            break;
+        }
+
+        const EndpointEvent ev = process_frame(m_pending.data());
+        m_pending.clear();
+
+        if (ev == EndpointEvent::SpeechEnd || (ev == EndpointEvent::SpeechStart && result == EndpointEvent::None)) {
+            result = ev;
+        }
+    }
+
+    return result;
+}
+
+EndpointEvent Endpointer::process_frame(const float* frame) {
+    const uint64_t frame_start = m_pos;
+    m_pos += m_frame_samples;
+
+    // Energy of the high-passed frame in dBFS
+    double energy = 0.0;
+    for (size_t i = 0; i < m_frame_samples; i++) {
+        const float x = frame[i];
+        m_hp_y = m_params.freq_thold > 0.0f ? m_hp_alpha * (m_hp_y + x - m_hp_x) : x;
+        m_hp_x = x;
+        energy += (double)m_hp_y * m_hp_y;
+    }
+    const float db = 10.0f * log10f((float)(energy / m_frame_samples) + 1e-10f);
+
+    if (!m_floor_init) {
+        m_floor_db = std::max(db, m_params.min_floor_db);
+        m_floor_init = true;
+    }
+
+    const bool above_start = db > m_floor_db + m_params.start_db;
+    const bool above_stop = db > m_floor_db + m_params.stop_db;
+
+    // Track the noise floor: follow drops quickly, rises slowly, and never
+    // rise while the player is talking
+    if (db < m_floor_db) {
+        m_floor_db += m_params.floor_fall_rate * (db - m_floor_db);
+    } else if (!m_in_speech && !above_start) {
+        const float max_rise = m_params.floor_rise_db_per_s * m_params.frame_ms / 1000.0f;
+        m_floor_db += std::min(db - m_floor_db, max_rise);
+    }
+    m_floor_db = std::max(m_floor_db, m_params.min_floor_db);
+
+    const int frame_ms = m_params.frame_ms;
+
+    if (!m_in_speech) {
+        if (m_candidate_frames == 0 ? above_start : above_stop) {
+            if (m_candidate_frames == 0) {
+                m_candidate_start = frame_start;
+            }
+            m_candidate_frames++;
+
+            if (m_candidate_frames * frame_ms >= m_params.min_speech_ms) {
+                m_in_speech = true;
+                m_sentence_end = false;
+                m_candidate_frames = 0;
+                m_speech_start = m_candidate_start;
+                m_speech_end = m_pos;
+                return EndpointEvent::SpeechStart;
+            }
+        } else {
+            m_candidate_frames = 0;
+        }
+
+        return EndpointEvent::None;
+    }
+
+    if (above_stop) {
+        m_speech_end = m_pos;
+    }
+
+    const uint64_t silence = m_pos - m_speech_end;
+    const int hangover_ms = m_sentence_end ? m_params.short_hangover_ms : m_params.hangover_ms;
+    const uint64_t hangover = (uint64_t)hangover_ms * m_sample_rate / 1000;
+    const bool too_long = m_params.max_speech_ms > 0 &&
+        (m_pos - m_speech_start) * 1000 >= (uint64_t)m_params.max_speech_ms * m_sample_rate;
+
+    if (silence >= hangover || too_long) {
+        m_in_speech = false;
+        m_sentence_end = false;
+
+        m_last_latency_ms = (int)(silence * 1000 / m_sample_rate);
+        m_sum_latency_ms += m_last_latency_ms;
+        m_n_endpoints++;
+
+        return EndpointEvent::SpeechEnd;
+    }
+
+    return EndpointEvent::None;
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Adaptive end-of-utterance detection.
+//
+// Frame energy is compared against a noise floor that is learned while the
+// player is silent, with separate start/stop thresholds (hysteresis) so
+// speech does not flicker on and off around a single level. The hangover
+// before an utterance is closed can be shortened when the caller knows the
+// transcript so far ends in a complete sentence.
+
+struct EndpointerParams {
+    int frame_ms = 20;
+
+    float freq_thold = 100.0f;         // high-pass cutoff applied before measuring energy
+
+    float start_db = 10.0f;            // above noise floor to enter speech
+    float stop_db = 6.0f;              // above noise floor to stay in speech
+    float min_floor_db = -65.0f;       // floor never drops below this (digital silence)
+    float floor_rise_db_per_s = 3.0f;  // how fast the floor follows rising noise
+    float floor_fall_rate = 0.2f;      // smoothing when the floor drops (0..1 per frame)
+
+    int min_speech_ms = 100;           // sustained energy before an utterance starts
+    int hangover_ms = 400;             // silence before the utterance is closed
+    int short_hangover_ms = 200;       // ... after a confident sentence ending
+    int max_speech_ms = 0;             // force an endpoint after this long (0 = off)
+};
+
+enum class EndpointEvent {
+    None,
+    SpeechStart,
+    SpeechEnd,
+};
+
+class Endpointer {
+public:
+    Endpointer(int sample_rate, const EndpointerParams& params = EndpointerParams());
+
+    // Feed audio whose first sample sits at sample position pos. Gaps or
+    // overlaps against the previous call resynchronize the clock.
+    // Returns SpeechEnd if an utterance closed in this block, otherwise
+    // SpeechStart if one opened, otherwise None.
+    EndpointEvent process(uint64_t pos, const float* samples, size_t n_samples);
+
+    // Forget the current utterance but keep the learned noise floor
+    void reset();
+
+    // Whether the transcript so far ends a sentence (set by the STT side)
+    void set_sentence_end_hint(bool sentence_end) { m_sentence_end = sentence_end; }
+
+    bool in_speech() const { return m_in_speech; }
+
+    // Sample positions of the last utterance, [start, end)
+    uint64_t speech_start() const { return m_speech_start; }
+    uint64_t speech_end() const { return m_speech_end; }
+
+    float noise_floor_db() const { return m_floor_db; }
+
+    // Time between the last speech frame and the endpoint decision
+    int last_latency_ms() const { return m_last_latency_ms; }
+    float mean_latency_ms() const { return m_n_endpoints ? (float)m_sum_latency_ms / m_n_endpoints : 0.0f; }
+    int endpoint_count() const { return m_n_endpoints; }
+
+private:
+    EndpointEvent process_frame(const float* frame);
+
+    int m_sample_rate;
+    EndpointerParams m_params;
+    size_t m_frame_samples;
+
+    // Frame assembly
+    std::vector<float> m_pending;
+    uint64_t m_pos = 0;           // sample position after the last frame consumed
+    uint64_t m_next_pos = 0;      // expected position of the next process() call
+
+    // One-pole high-pass state, carried across frames
+    float m_hp_alpha;
+    float m_hp_y = 0.0f;
+    float m_hp_x = 0.0f;
+
+    // Noise floor
+    bool m_floor_init = false;
+    float m_floor_db;
+
+    // Utterance state
+    bool m_in_speech = false;
+    bool m_sentence_end = false;
+    int m_candidate_frames = 0;
+    uint64_t m_candidate_start = 0;
+    uint64_t m_speech_start = 0;
+    uint64_t m_speech_end = 0;
+
+    // Metrics
+    int m_last_latency_ms = 0;
+    int64_t m_sum_latency_ms = 0;
+    int m_n_endpoints = 0;
+};
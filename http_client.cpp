@@ -0,0 +1,349 @@
+#include "http_client.h"
+
+#include <curl/curl.h>
+#include <cstdlib>
+#include <iostream>
+
+static size_t WriteCallback(void* contents, size_t size, size_t nmemb, void* userp) {
+    const HttpClient::DataCallback* onData = (const HttpClient::DataCallback*)userp;
+    return (*onData)((const char*)contents, size * nmemb) ? size * nmemb : 0;
+}
+
+// Abort the transfer once the caller sets the cancel flag
+static int CancelCallback(void* clientp, curl_off_t, curl_off_t, curl_off_t, curl_off_t) {
+    const std::atomic_bool* cancel = (const std::atomic_bool*)clientp;
+    return *cancel ? 1 : 0;
+}
+
+// The share object is used from several threads; one mutex per kind of data
+static void LockShare(CURL*, curl_lock_data data, curl_lock_access, void* userp) {
+    std::mutex* locks = (std::mutex*)userp;
+    locks[data % 16].lock();
+}
+
+static void UnlockShare(CURL*, curl_lock_data data, void* userp) {
+    std::mutex* locks = (std::mutex*)userp;
+    locks[data % 16].unlock();
+}
+
+// curl_global_init must not run while another thread uses curl (before
+// libcurl 7.84 it is not thread-safe at all), so it runs once, for the
+// first client, and the process never calls curl_global_cleanup
+static void InitCurl() {
+    static std::once_flag once;
+    std::call_once(once, [] { curl_global_init(CURL_GLOBAL_DEFAULT); });
+}
+
+// SSL CA certificate bundle
+static void ResolveCaBundle(HttpClientConfig& config) {
+    if (config.caBundle.empty()) {
+        const char* caBundle = getenv("CURL_CA_BUNDLE");
+        if (caBundle) {
+            config.caBundle = caBundle;
+        }
+#ifdef _WIN32
+        else {
+            // Try common MSYS2 locations
+            config.caBundle = "C:/msys64/usr/ssl/certs/ca-bundle.crt";
+        }
+#endif
+    }
+}
+
+static curl_slist* BuildHeaders(const HttpClientConfig& config) {
+    curl_slist* headers = nullptr;
+    for (const auto& header : config.headers) {
+        headers = curl_slist_append(headers, header.c_str());
+    }
+    return headers;
+}
+
+// Options that are the same for every request, set once per handle
+static void SetCommonOptions(CURL* curl, const HttpClientConfig& config, curl_slist* headers) {
+    curl_easy_setopt(curl, CURLOPT_URL, config.url.c_str());
+    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+    curl_easy_setopt(curl, CURLOPT_POST, 1L);
+    curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+
+    // Keep the connection alive between turns
+    curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L);
+    curl_easy_setopt(curl, CURLOPT_TCP_KEEPIDLE, 30L);
+    curl_easy_setopt(curl, CURLOPT_TCP_KEEPINTVL, 15L);
+    curl_easy_setopt(curl, CURLOPT_DNS_CACHE_TIMEOUT, 600L);
+    if (config.http2) {
+        curl_easy_setopt(curl, CURLOPT_HTTP_VERSION, (long)CURL_HTTP_VERSION_2TLS);
+    }
+    if (!config.caBundle.empty()) {
+        curl_easy_setopt(curl, CURLOPT_CAINFO, config.caBundle.c_str());
+    }
+}
+
+HttpClient::HttpClient(const HttpClientConfig& config) : m_config(config) {
+    InitCurl();
+
+    ResolveCaBundle(m_config);
+    m_headers = BuildHeaders(m_config);
+
+    m_share = curl_share_init();
+    if (m_share) {
+        curl_share_setopt(m_share, CURLSHOPT_LOCKFUNC, LockShare);
+        curl_share_setopt(m_share, CURLSHOPT_UNLOCKFUNC, UnlockShare);
+        curl_share_setopt(m_share, CURLSHOPT_USERDATA, (void*)m_shareLocks);
+        curl_share_setopt(m_share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+        curl_share_setopt(m_share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+        curl_share_setopt(m_share, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT);
+    }
+}
+
+HttpClient::~HttpClient() {
+    for (CURL* curl : m_idle) {
+        curl_easy_cleanup(curl);
+    }
+    if (m_share) {
+        curl_share_cleanup(m_share);
+    }
+    curl_slist_free_all(m_headers);
+}
+
+CURL* HttpClient::acquire() {
+    {
+        std::lock_guard<std::mutex> lock(m_poolMutex);
+        if (!m_idle.empty()) {
+            CURL* curl = m_idle.back();
+            m_idle.pop_back();
+            return curl;
+        }
+    }
+
+    CURL* curl = curl_easy_init();
+    if (!curl) {
+        return nullptr;
+    }
+
+    SetCommonOptions(curl, m_config, m_headers);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
+    curl_easy_setopt(curl, CURLOPT_XFERINFOFUNCTION, CancelCallback);
+    if (m_share) {
+        curl_easy_setopt(curl, CURLOPT_SHARE, m_share);
+    }
+
+    return curl;
+}
+
+void HttpClient::release(CURL* curl) {
+    std::lock_guard<std::mutex> lock(m_poolMutex);
+    m_idle.push_back(curl);
+}
+
+bool HttpClient::post(const std::string& body, std::string& response, const std::atomic_bool* cancel, long* status,
+                      const HttpTimeouts& timeouts) {
+    return post(body, [&response](const char* data, size_t size) {
+        response.append(data, size);
+        return true;
+    }, cancel, status, timeouts);
+}
+
+bool HttpClient::post(const std::string& body, const DataCallback& onData, const std::atomic_bool* cancel, long* status,
+                      const HttpTimeouts& timeouts) {
+    if (status) {
+        *status = 0;
+    }
+
+    CURL* curl = acquire();
+    if (!curl) {
+        std::cerr << "CURL error: failed to create a handle" << std::endl;
+        return false;
+    }
+
+    curl_easy_setopt(curl, CURLOPT_POSTFIELDS, body.c_str());
+    curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE_LARGE, (curl_off_t)body.size());
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, (void*)&onData);
+    curl_easy_setopt(curl, CURLOPT_XFERINFODATA, (void*)cancel);
+    curl_easy_setopt(curl, CURLOPT_NOPROGRESS, cancel ? 0L : 1L);
+    curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT_MS, timeouts.connectTimeoutMs > 0 ? timeouts.connectTimeoutMs : m_config.connectTimeoutMs);
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT_MS, timeouts.timeoutMs > 0 ? timeouts.timeoutMs : m_config.timeoutMs);
+
+    CURLcode res = curl_easy_perform(curl);
+    // Stopped by the caller: cancelled, or the data callback returned false
+    if (res != CURLE_OK && res != CURLE_ABORTED_BY_CALLBACK && res != CURLE_WRITE_ERROR) {
+        std::cerr << "CURL error: " << curl_easy_strerror(res) << std::endl;
+    }
+
+    if (status) {
+        curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, status);
+    }
+
+    // The handle (and its connection) stays in the pool for the next turn
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, nullptr);
+    curl_easy_setopt(curl, CURLOPT_XFERINFODATA, nullptr);
+    release(curl);
+
+    return res == CURLE_OK;
+}
+
+struct HttpMultiClient::Transfer {
+    CURL* curl = nullptr;
+    std::string body;
+    std::string response;
+    DoneCallback onDone;
+};
+
+static size_t AppendCallback(void* contents, size_t size, size_t nmemb, void* userp) {
+    std::string* response = (std::string*)userp;
+    response->append((const char*)contents, size * nmemb);
+    return size * nmemb;
+}
+
+HttpMultiClient::HttpMultiClient(const HttpClientConfig& config, long maxConnections) : m_config(config) {
+    InitCurl();
+
+    ResolveCaBundle(m_config);
+    m_headers = BuildHeaders(m_config);
+
+    m_multi = curl_multi_init();
+    if (m_multi) {
+        curl_multi_setopt(m_multi, CURLMOPT_PIPELINING, (long)CURLPIPE_MULTIPLEX);
+        curl_multi_setopt(m_multi, CURLMOPT_MAX_HOST_CONNECTIONS, maxConnections);
+        curl_multi_setopt(m_multi, CURLMOPT_MAXCONNECTS, maxConnections);
+        m_thread = std::thread(&HttpMultiClient::run, this);
+    } else {
+        std::cerr << "CURL error: failed to create a multi handle" << std::endl;
+    }
+}
+
+HttpMultiClient::~HttpMultiClient() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    if (m_multi) {
+        curl_multi_wakeup(m_multi);
+    }
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+
+    for (Transfer* transfer : m_active) {
+        curl_multi_remove_handle(m_multi, transfer->curl);
+        curl_easy_cleanup(transfer->curl);
+        delete transfer;
+    }
+    for (Transfer* transfer : m_queue) {
+        delete transfer;
+    }
+    for (CURL* curl : m_idle) {
+        curl_easy_cleanup(curl);
+    }
+    if (m_multi) {
+        curl_multi_cleanup(m_multi);
+    }
+    curl_slist_free_all(m_headers);
+}
+
+bool HttpMultiClient::post(std::string body, DoneCallback onDone) {
+    if (!m_multi) {
+        return false;
+    }
+
+    Transfer* transfer = new Transfer();
+    transfer->body = std::move(body);
+    transfer->onDone = std::move(onDone);
+
+    m_pending++;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_queue.push_back(transfer);
+    }
+
+    curl_multi_wakeup(m_multi);
+    return true;
+}
+
+void HttpMultiClient::start(Transfer* transfer) {
+    CURL* curl = nullptr;
+    if (!m_idle.empty()) {
+        curl = m_idle.back();
+        m_idle.pop_back();
+    } else {
+        curl = curl_easy_init();
+        if (curl) {
+            SetCommonOptions(curl, m_config, m_headers);
+            curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, AppendCallback);
+            curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT_MS, m_config.connectTimeoutMs);
+            curl_easy_setopt(curl, CURLOPT_TIMEOUT_MS, m_config.timeoutMs);
+            // Wait for a connection that can multiplex rather than opening more
+            curl_easy_setopt(curl, CURLOPT_PIPEWAIT, 1L);
+        }
+    }
+
+    if (!curl) {
+        std::cerr << "CURL error: failed to create a handle" << std::endl;
+        transfer->onDone(false, 0, transfer->response);
+        delete transfer;
+        m_pending--;
+        return;
+    }
+
+    transfer->curl = curl;
+    curl_easy_setopt(curl, CURLOPT_POSTFIELDS, transfer->body.c_str());
+    curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE_LARGE, (curl_off_t)transfer->body.size());
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, (void*)&transfer->response);
+    curl_easy_setopt(curl, CURLOPT_PRIVATE, (void*)transfer);
+
+    curl_multi_add_handle(m_multi, curl);
+    m_active.insert(transfer);
+}
+
+void HttpMultiClient::run() {
+    while (true) {
+        std::vector<Transfer*> queued;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_stop) {
+                break;
+            }
+            queued.swap(m_queue);
+        }
+        for (Transfer* transfer : queued) {
+            start(transfer);
+        }
+
+        int running = 0;
+        curl_multi_perform(m_multi, &running);
+
+        int left = 0;
+        while (CURLMsg* msg = curl_multi_info_read(m_multi, &left)) {
+            if (msg->msg != CURLMSG_DONE) {
+                continue;
+            }
+
+            // msg is invalid once the handle is removed
+            CURL* curl = msg->easy_handle;
+            const CURLcode res = msg->data.result;
+
+            char* priv = nullptr;
+            curl_easy_getinfo(curl, CURLINFO_PRIVATE, &priv);
+            Transfer* transfer = (Transfer*)priv;
+
+            long status = 0;
+            curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &status);
+            if (res != CURLE_OK) {
+                std::cerr << "CURL error: " << curl_easy_strerror(res) << std::endl;
+            }
+
+            // The handle (and its connection) stays in the pool
+            curl_multi_remove_handle(m_multi, curl);
+            curl_easy_setopt(curl, CURLOPT_WRITEDATA, nullptr);
+            curl_easy_setopt(curl, CURLOPT_PRIVATE, nullptr);
+            m_idle.push_back(curl);
+            m_active.erase(transfer);
+
+            transfer->onDone(res == CURLE_OK, status, transfer->response);
+            delete transfer;
+            m_pending--;
+        }
+
+        // Sleep until a socket is ready, a timeout is due or post() wakes us
+        curl_multi_poll(m_multi, nullptr, 0, 1000, nullptr);
+    }
+}
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+typedef void CURL;
+typedef void CURLSH;
+typedef void CURLM;
+struct curl_slist;
+
+struct HttpClientConfig {
+    std::string url;
+    std::vector<std::string> headers;  // "Name: value", sent with every request
+    std::string caBundle;              // empty: CURL_CA_BUNDLE, then curl's default
+    long connectTimeoutMs = 10000;
+    long timeoutMs = 60000;
+    bool http2 = true;                 // negotiated over TLS, falls back to HTTP/1.1
+};
+
+// Per-request limits; 0 keeps the client's configuration
+struct HttpTimeouts {
+    long connectTimeoutMs = 0;
+    long timeoutMs = 0;
+};
+
+// POST client for one endpoint that keeps its connections warm.
+//
+// Requests reuse easy handles from a pool, so the TCP connection, TLS
+// session and resolved address of the previous turn are reused instead of
+// paying DNS + TCP + TLS handshakes to the API every time. Handles share
+// one DNS cache, TLS session cache and connection pool, so concurrent
+// requests (e.g. a speculative one) benefit too. Headers are built once.
+//
+// post() may be called from several threads at once.
+class HttpClient {
+public:
+    explicit HttpClient(const HttpClientConfig& config);
+    ~HttpClient();
+
+    HttpClient(const HttpClient&) = delete;
+    HttpClient& operator=(const HttpClient&) = delete;
+
+    // Send body and collect the response. Setting *cancel aborts the
+    // transfer. status gets the HTTP status (0 if none was received).
+    // Returns false on transport errors (including timeouts) and
+    // cancellation.
+    bool post(const std::string& body, std::string& response, const std::atomic_bool* cancel = nullptr, long* status = nullptr,
+              const HttpTimeouts& timeouts = HttpTimeouts());
+
+    // Receives the response body piece by piece as it arrives; return
+    // false to stop the transfer (post() then returns false)
+    using DataCallback = std::function<bool(const char* data, size_t size)>;
+
+    // Like post() above, but streams the response to onData
+    bool post(const std::string& body, const DataCallback& onData, const std::atomic_bool* cancel = nullptr, long* status = nullptr,
+              const HttpTimeouts& timeouts = HttpTimeouts());
+
+    const std::string& url() const { return m_config.url; }
+
+private:
+    CURL* acquire();
+    void release(CURL* curl);
+
+    HttpClientConfig m_config;
+    curl_slist* m_headers = nullptr;
+    CURLSH* m_share = nullptr;
+    std::mutex m_shareLocks[16];  // one per curl_lock_data
+
+    std::mutex m_poolMutex;
+    std::vector<CURL*> m_idle;
+};
+
+// POST client for one endpoint that runs all requests on a single thread
+// with a curl_multi event loop, for processes driving many conversations
+// at once (see NPCChatHub).
+//
+// Requests don't take a thread each: transfers are multiplexed over at most
+// maxConnections pooled connections (as HTTP/2 streams where the server
+// supports it, otherwise queued for a free keep-alive connection).
+class HttpMultiClient {
+public:
+    // Called on the event loop thread when a request ends, so keep it
+    // short. ok is false on transport errors (including timeouts).
+    using DoneCallback = std::function<void(bool ok, long status, std::string& response)>;
+
+    explicit HttpMultiClient(const HttpClientConfig& config, long maxConnections = 8);
+
+    // Aborts requests in flight without calling their callbacks
+    ~HttpMultiClient();
+
+    HttpMultiClient(const HttpMultiClient&) = delete;
+    HttpMultiClient& operator=(const HttpMultiClient&) = delete;
+
+    // Queue a request. May be called from any thread, including callbacks.
+    // Returns false (and onDone is not called) if curl could not be set up.
+    bool post(std::string body, DoneCallback onDone);
+
+    // Requests queued or in flight
+    size_t pending() const { return m_pending; }
+
+    const std::string& url() const { return m_config.url; }
+
+private:
+    struct Transfer;
+
+    void run();
+    void start(Transfer* transfer);
+
+    HttpClientConfig m_config;
+    curl_slist* m_headers = nullptr;
+    CURLM* m_multi = nullptr;
+
+    std::mutex m_mutex;
+    std::vector<Transfer*> m_queue;  // posted, not started yet
+    bool m_stop = false;
+    std::atomic<size_t> m_pending{0};
+
+    // Only used by the event loop thread
+    std::set<Transfer*> m_active;
+    std::vector<CURL*> m_idle;
+
+    std::thread m_thread;
+};
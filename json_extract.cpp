@@ -0,0 +1,439 @@
+#include "json_extract.h"
+
+#include <cstdlib>
+
+static bool isWhitespace(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+static int hexDigit(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+JsonExtractor::JsonExtractor(const std::vector<std::string>& paths) {
+    for (size_t i = 0; i < paths.size() && i < 32; i++) {
+        std::vector<Segment> segments;
+
+        size_t start = 0;
+        while (start <= paths[i].size()) {
+            size_t end = paths[i].find('.', start);
+            if (end == std::string::npos) {
+                end = paths[i].size();
+            }
+
+            Segment segment;
+            segment.key = paths[i].substr(start, end - start);
+            segment.index = -1;
+            if (!segment.key.empty() && segment.key.find_first_not_of("0123456789") == std::string::npos) {
+                segment.index = strtol(segment.key.c_str(), nullptr, 10);
+            }
+            segments.push_back(segment);
+
+            start = end + 1;
+        }
+
+        m_paths.push_back(segments);
+    }
+
+    m_key.reserve(64);
+    m_value.reserve(256);
+    reset();
+}
+
+void JsonExtractor::reset() {
+    m_stack.clear();
+    m_state = State::Value;
+    m_inKey = false;
+    m_capture = false;
+    m_found = 0;
+    m_key.clear();
+    m_value.clear();
+    m_unicodeDigits = 0;
+    m_highSurrogate = 0;
+
+    // Every path matches the (empty) path of the root
+    m_valueMask = m_paths.size() == 32 ? ~0u : (1u << m_paths.size()) - 1;
+}
+
+bool JsonExtractor::feed(const char* data, size_t size) {
+    for (size_t i = 0; i < size; i++) {
+        if (!step(data[i])) {
+            m_state = State::Error;
+            return false;
+        }
+    }
+    return m_state != State::Error;
+}
+
+bool JsonExtractor::step(char c) {
+    switch (m_state) {
+        case State::Value:
+            if (isWhitespace(c)) {
+                return true;
+            }
+            return beginValue(c);
+
+        case State::FirstElement:
+            if (isWhitespace(c)) {
+                return true;
+            }
+            if (c == ']') {
+                m_stack.pop_back();
+                endValue();
+                return true;
+            }
+            return beginValue(c);
+
+        case State::FirstKey:
+        case State::Key:
+            if (isWhitespace(c)) {
+                return true;
+            }
+            if (c == '}' && m_state == State::FirstKey) {
+                m_stack.pop_back();
+                endValue();
+                return true;
+            }
+            if (c != '"') {
+                return false;
+            }
+            m_key.clear();
+            m_inKey = true;
+            m_state = State::String;
+            return true;
+
+        case State::Colon:
+            if (isWhitespace(c)) {
+                return true;
+            }
+            if (c != ':') {
+                return false;
+            }
+            m_state = State::Value;
+            return true;
+
+        case State::AfterValue: {
+            if (isWhitespace(c)) {
+                return true;
+            }
+
+            Frame& frame = m_stack.back();
+            if (c == ',') {
+                if (frame.array) {
+                    frame.index++;
+                    m_valueMask = 0;
+                    const size_t depth = m_stack.size();
+                    for (size_t p = 0; p < m_paths.size(); p++) {
+                        if (((frame.parentMask >> p) & 1) && m_paths[p].size() >= depth &&
+                            m_paths[p][depth - 1].index == frame.index) {
+                            m_valueMask |= 1u << p;
+                        }
+                    }
+                    m_state = State::Value;
+                } else {
+                    m_state = State::Key;
+                }
+                return true;
+            }
+            if (c == (frame.array ? ']' : '}')) {
+                m_stack.pop_back();
+                endValue();
+                return true;
+            }
+            return false;
+        }
+
+        case State::String:
+            if (c == '"') {
+                if (m_highSurrogate) {
+                    appendCodePoint(0xFFFD);
+                }
+                if (m_inKey) {
+                    endKey();
+                } else {
+                    endValue();
+                }
+                return true;
+            }
+            if (c == '\\') {
+                m_state = State::Escape;
+                return true;
+            }
+            if ((unsigned char)c < 0x20) {
+                return false;  // control characters must be escaped
+            }
+            if (m_highSurrogate) {
+                appendCodePoint(0xFFFD);
+            }
+            appendChar(c);
+            return true;
+
+        case State::Escape: {
+            if (c == 'u') {
+                m_unicode = 0;
+                m_unicodeDigits = 0;
+                m_state = State::Unicode;
+                return true;
+            }
+
+            char decoded;
+            switch (c) {
+                case '"':  decoded = '"'; break;
+                case '\\': decoded = '\\'; break;
+                case '/':  decoded = '/'; break;
+                case 'b':  decoded = '\b'; break;
+                case 'f':  decoded = '\f'; break;
+                case 'n':  decoded = '\n'; break;
+                case 'r':  decoded = '\r'; break;
+                case 't':  decoded = '\t'; break;
+                default:   return false;
+            }
+            if (m_highSurrogate) {
+                appendCodePoint(0xFFFD);
+            }
+            appendChar(decoded);
+            m_state = State::String;
+            return true;
+        }
+
+        case State::Unicode: {
+            const int digit = hexDigit(c);
+            if (digit < 0) {
+                return false;
+            }
+            m_unicode = (m_unicode << 4) | (uint32_t)digit;
+            if (++m_unicodeDigits < 4) {
+                return true;
+            }
+
+            // A high surrogate waits for the low one that follows it
+            if (m_unicode >= 0xD800 && m_unicode <= 0xDBFF) {
+                if (m_highSurrogate) {
+                    appendCodePoint(0xFFFD);
+                }
+                m_highSurrogate = m_unicode;
+            } else if (m_unicode >= 0xDC00 && m_unicode <= 0xDFFF) {
+                if (m_highSurrogate) {
+                    appendCodePoint(0x10000 + ((m_highSurrogate - 0xD800) << 10) + (m_unicode - 0xDC00));
+                } else {
+                    appendCodePoint(0xFFFD);
+                }
+            } else {
+                if (m_highSurrogate) {
+                    appendCodePoint(0xFFFD);
+                }
+                appendCodePoint(m_unicode);
+            }
+            m_state = State::String;
+            return true;
+        }
+
+        case State::Keyword:
+            if (c != m_keyword[m_keywordPos]) {
+                return false;
+            }
+            if (m_keyword[++m_keywordPos] == '\0') {
+                endValue();
+            }
+            return true;
+
+        case State::Number:
+            if (stepNumber(c)) {
+                return true;
+            }
+
+            // Anything else ends the number, which must be complete by then
+            if (m_number != NumberPart::Zero && m_number != NumberPart::Integer &&
+                m_number != NumberPart::Fraction && m_number != NumberPart::ExponentDigits) {
+                return false;
+            }
+            endValue();
+            return step(c);
+
+        case State::Done:
+            return isWhitespace(c);
+
+        case State::Error:
+            return false;
+    }
+
+    return false;
+}
+
+bool JsonExtractor::beginValue(char c) {
+    // Paths that end exactly here
+    uint32_t exact = 0;
+    for (size_t p = 0; p < m_paths.size(); p++) {
+        if (((m_valueMask >> p) & 1) && m_paths[p].size() == m_stack.size()) {
+            exact |= 1u << p;
+        }
+    }
+    m_found |= exact;
+
+    if (c == '"') {
+        m_inKey = false;
+        m_capture = exact != 0;
+        m_state = State::String;
+        return true;
+    }
+
+    if (c == '{' || c == '[') {
+        Frame frame;
+        frame.array = c == '[';
+        frame.index = 0;
+        frame.parentMask = m_valueMask & ~exact;
+        m_stack.push_back(frame);
+
+        if (frame.array) {
+            m_valueMask = 0;
+            const size_t depth = m_stack.size();
+            for (size_t p = 0; p < m_paths.size(); p++) {
+                if (((frame.parentMask >> p) & 1) && m_paths[p][depth - 1].index == 0) {
+                    m_valueMask |= 1u << p;
+                }
+            }
+            m_state = State::FirstElement;
+        } else {
+            m_state = State::FirstKey;
+        }
+        return true;
+    }
+
+    if (c == 't' || c == 'f' || c == 'n') {
+        m_keyword = c == 't' ? "true" : (c == 'f' ? "false" : "null");
+        m_keywordPos = 1;
+        m_state = State::Keyword;
+        return true;
+    }
+
+    if (c == '-' || (c >= '0' && c <= '9')) {
+        m_number = c == '-' ? NumberPart::Sign : (c == '0' ? NumberPart::Zero : NumberPart::Integer);
+        m_state = State::Number;
+        return true;
+    }
+
+    return false;
+}
+
+bool JsonExtractor::stepNumber(char c) {
+    const bool digit = c >= '0' && c <= '9';
+
+    switch (m_number) {
+        case NumberPart::Sign:
+            if (!digit) {
+                return false;
+            }
+            m_number = c == '0' ? NumberPart::Zero : NumberPart::Integer;
+            return true;
+
+        case NumberPart::Zero:
+        case NumberPart::Integer:
+            if (digit && m_number == NumberPart::Integer) {
+                return true;
+            }
+            if (c == '.') {
+                m_number = NumberPart::Dot;
+                return true;
+            }
+            if (c == 'e' || c == 'E') {
+                m_number = NumberPart::Exponent;
+                return true;
+            }
+            return false;
+
+        case NumberPart::Dot:
+            if (!digit) {
+                return false;
+            }
+            m_number = NumberPart::Fraction;
+            return true;
+
+        case NumberPart::Fraction:
+            if (digit) {
+                return true;
+            }
+            if (c == 'e' || c == 'E') {
+                m_number = NumberPart::Exponent;
+                return true;
+            }
+            return false;
+
+        case NumberPart::Exponent:
+            if (c == '+' || c == '-') {
+                m_number = NumberPart::ExponentSign;
+                return true;
+            }
+            if (!digit) {
+                return false;
+            }
+            m_number = NumberPart::ExponentDigits;
+            return true;
+
+        case NumberPart::ExponentSign:
+            if (!digit) {
+                return false;
+            }
+            m_number = NumberPart::ExponentDigits;
+            return true;
+
+        case NumberPart::ExponentDigits:
+            return digit;
+    }
+
+    return false;
+}
+
+void JsonExtractor::endValue() {
+    m_capture = false;
+    m_highSurrogate = 0;
+    m_state = m_stack.empty() ? State::Done : State::AfterValue;
+}
+
+void JsonExtractor::endKey() {
+    m_inKey = false;
+    m_highSurrogate = 0;
+
+    // The next value matches the paths whose segment at this depth is the key
+    const Frame& frame = m_stack.back();
+    const size_t depth = m_stack.size();
+    m_valueMask = 0;
+    for (size_t p = 0; p < m_paths.size(); p++) {
+        if (((frame.parentMask >> p) & 1) && m_paths[p][depth - 1].key == m_key) {
+            m_valueMask |= 1u << p;
+        }
+    }
+
+    m_state = State::Colon;
+}
+
+void JsonExtractor::appendChar(char c) {
+    if (m_inKey) {
+        m_key += c;
+    } else if (m_capture) {
+        m_value += c;
+    }
+}
+
+void JsonExtractor::appendCodePoint(uint32_t cp) {
+    m_highSurrogate = 0;
+
+    // UTF-8
+    if (cp < 0x80) {
+        appendChar((char)cp);
+    } else if (cp < 0x800) {
+        appendChar((char)(0xC0 | (cp >> 6)));
+        appendChar((char)(0x80 | (cp & 0x3F)));
+    } else if (cp < 0x10000) {
+        appendChar((char)(0xE0 | (cp >> 12)));
+        appendChar((char)(0x80 | ((cp >> 6) & 0x3F)));
+        appendChar((char)(0x80 | (cp & 0x3F)));
+    } else {
+        appendChar((char)(0xF0 | (cp >> 18)));
+        appendChar((char)(0x80 | ((cp >> 12) & 0x3F)));
+        appendChar((char)(0x80 | ((cp >> 6) & 0x3F)));
+        appendChar((char)(0x80 | (cp & 0x3F)));
+    }
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Incremental JSON parser that picks values out by path, e.g.
+// "choices.0.message.content" (object keys and array indices separated by
+// '.').
+//
+// Bytes are fed as they arrive, split anywhere, and parsed in one pass
+// without building a document. A string at one of the paths is decoded
+// (all escapes, including \uXXXX and surrogate pairs, become UTF-8) into
+// value(), which keeps its capacity across reset(), so a parser reused for
+// every streamed event does not allocate. found() also reports paths whose
+// value is not a string (e.g. an "error" object).
+class JsonExtractor {
+public:
+    // At most 32 paths
+    explicit JsonExtractor(const std::vector<std::string>& paths);
+
+    // Parse more of the document. Returns false once it turned out not to
+    // be valid JSON.
+    bool feed(const char* data, size_t size);
+    bool feed(const std::string& data) { return feed(data.data(), data.size()); }
+
+    // Whether one complete JSON value has been parsed
+    bool complete() const { return m_state == State::Done; }
+
+    // Whether the value at paths[index] was seen (it may still be arriving)
+    bool found(size_t index) const { return (m_found >> index) & 1; }
+
+    // The decoded string(s) at the paths seen so far
+    const std::string& value() const { return m_value; }
+
+    // Start over for a new document
+    void reset();
+
+private:
+    enum class State {
+        Value,         // expecting a value
+        FirstElement,  // after '[': a value or ']'
+        FirstKey,      // after '{': a key or '}'
+        Key,           // after ',' in an object: a key
+        Colon,
+        AfterValue,    // ',' or the end of the enclosing object / array
+        String,
+        Escape,
+        Unicode,       // the hex digits of \uXXXX
+        Keyword,       // true, false, null
+        Number,
+        Done,
+        Error,
+    };
+
+    // Position in the number grammar: -?(0|[1-9][0-9]*)(.[0-9]+)?([eE][+-]?[0-9]+)?
+    enum class NumberPart {
+        Sign,          // after '-': a digit
+        Zero,          // a leading 0: no more digits
+        Integer,
+        Dot,           // a digit
+        Fraction,
+        Exponent,      // after 'e': a sign or a digit
+        ExponentSign,  // a digit
+        ExponentDigits,
+    };
+
+    struct Segment {
+        std::string key;
+        long index;  // -1 if key is not an array index
+    };
+
+    struct Frame {
+        bool array;
+        long index;
+        uint32_t parentMask;  // paths matching up to this container
+    };
+
+    bool step(char c);
+    bool stepNumber(char c);
+    bool beginValue(char c);
+    void endValue();
+    void endKey();
+    void appendCodePoint(uint32_t cp);
+    void appendChar(char c);
+
+    std::vector<std::vector<Segment>> m_paths;
+    std::vector<Frame> m_stack;
+
+    State m_state = State::Value;
+    bool m_inKey = false;        // the string being parsed is an object key
+    bool m_capture = false;      // the string being parsed goes to m_value
+    uint32_t m_valueMask = 0;    // paths matching the position of the next value
+    uint32_t m_found = 0;
+
+    std::string m_key;
+    std::string m_value;
+
+    const char* m_keyword = nullptr;  // true, false or null being read
+    size_t m_keywordPos = 0;
+    NumberPart m_number = NumberPart::Integer;
+
+    uint32_t m_unicode = 0;      // \uXXXX being read
+    int m_unicodeDigits = 0;
+    uint32_t m_highSurrogate = 0;
+};
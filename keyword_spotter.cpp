@@ -0,0 +1,170 @@
+#include "keyword_spotter.h"
+
+#include <cmath>
+#include <algorithm>
+#include <limits>
+
+// Frames more than this far below the loudest one (log10 power, i.e. 30 dB)
+// count as silence when trimming
+static const float TRIM_RANGE = 3.0f;
+
+// Mel energies are clamped to this far below the loudest one (log10)
+static const float MEL_RANGE = 4.0f;
+
+// Phrases whose lengths differ by more than this factor never match
+static const float MAX_LENGTH_RATIO = 2.0f;
+
+// Returned when two phrases cannot be compared
+static const float NO_MATCH = std::numeric_limits<float>::max();
+
+KeywordSpotter::KeywordSpotter(float threshold) : m_threshold(threshold), m_mel(N_MEL) {
+    m_dct.resize((size_t)N_MFCC * N_MEL);
+    for (int k = 0; k < N_MFCC; k++) {
+        const double scale = std::sqrt((k == 0 ? 1.0 : 2.0) / N_MEL);
+        for (int n = 0; n < N_MEL; n++) {
+            m_dct[(size_t)k * N_MEL + n] = (float)(scale * std::cos(M_PI * k * (n + 0.5) / N_MEL));
+        }
+    }
+}
+
+bool KeywordSpotter::add_template(const std::string& command, const float* samples, size_t n_samples) {
+    Template t;
+    t.command = command;
+    t.n_frames = compute_mfcc(samples, n_samples, t.mfcc);
+    if (t.n_frames == 0) {
+        return false;
+    }
+
+    // Room for slower speech plus the margins around a detected utterance
+    const size_t n_speech = (size_t)t.n_frames * MelStream::HOP + MelStream::N_FFT;
+    m_max_samples = std::max(m_max_samples, (size_t)(MAX_LENGTH_RATIO * n_speech) + MelStream::SAMPLE_RATE / 2);
+
+    m_templates.push_back(std::move(t));
+    return true;
+}
+
+std::string KeywordSpotter::match(const float* samples, size_t n_samples, float* distance) {
+    float best = NO_MATCH;
+    const Template* best_t = nullptr;
+
+    if (!m_templates.empty() && n_samples <= m_max_samples) {
+        const int n_frames = compute_mfcc(samples, n_samples, m_mfcc);
+        for (const Template& t : m_templates) {
+            const float d = dtw(m_mfcc.data(), n_frames, t.mfcc.data(), t.n_frames);
+            if (d < best) {
+                best = d;
+                best_t = &t;
+            }
+        }
+    }
+
+    if (distance) {
+        *distance = best;
+    }
+
+    return best_t && best <= m_threshold ? best_t->command : "";
+}
+
+int KeywordSpotter::compute_mfcc(const float* samples, size_t n_samples, std::vector<float>& mfcc) {
+    mfcc.clear();
+    if (n_samples < (size_t)MelStream::N_FFT) {
+        return 0;
+    }
+
+    const int n_all = 1 + (int)((n_samples - MelStream::N_FFT) / MelStream::HOP);
+
+    m_logmel.resize((size_t)n_all * N_MEL);
+    std::vector<float> energy(n_all);
+    for (int i = 0; i < n_all; i++) {
+        float* out = m_logmel.data() + (size_t)i * N_MEL;
+        m_mel.compute_frame(samples + (size_t)i * MelStream::HOP, out);
+
+        float power = 0.0f;
+        for (int j = 0; j < N_MEL; j++) {
+            power += std::pow(10.0f, out[j]);
+        }
+        energy[i] = std::log10(std::max(power, 1e-10f));
+    }
+
+    // Keep the frames from the first to the last one near the peak level
+    const float floor = *std::max_element(energy.begin(), energy.end()) - TRIM_RANGE;
+    int first = 0;
+    int last = n_all - 1;
+    while (first < last && energy[first] < floor) {
+        first++;
+    }
+    while (last > first && energy[last] < floor) {
+        last--;
+    }
+    const int n_frames = last - first + 1;
+
+    // Limit the dynamic range so background noise filling in the quiet
+    // bands does not dominate the distance
+    const float* kept = m_logmel.data() + (size_t)first * N_MEL;
+    const float mel_floor = *std::max_element(kept, kept + (size_t)n_frames * N_MEL) - MEL_RANGE;
+
+    mfcc.assign((size_t)n_frames * N_MFCC, 0.0f);
+    for (int i = 0; i < n_frames; i++) {
+        const float* in = m_logmel.data() + (size_t)(first + i) * N_MEL;
+        float* out = mfcc.data() + (size_t)i * N_MFCC;
+        for (int k = 0; k < N_MFCC; k++) {
+            const float* basis = m_dct.data() + (size_t)k * N_MEL;
+            float sum = 0.0f;
+            for (int j = 0; j < N_MEL; j++) {
+                sum += basis[j] * std::max(in[j], mel_floor);
+            }
+            out[k] = sum;
+        }
+    }
+
+    // Cepstral mean normalization removes the microphone / voice coloring
+    for (int k = 0; k < N_MFCC; k++) {
+        float mean = 0.0f;
+        for (int i = 0; i < n_frames; i++) {
+            mean += mfcc[(size_t)i * N_MFCC + k];
+        }
+        mean /= n_frames;
+        for (int i = 0; i < n_frames; i++) {
+            mfcc[(size_t)i * N_MFCC + k] -= mean;
+        }
+    }
+
+    return n_frames;
+}
+
+float KeywordSpotter::dtw(const float* a, int n_a, const float* b, int n_b) {
+    if (n_a == 0 || n_b == 0 ||
+        n_a > MAX_LENGTH_RATIO * n_b || n_b > MAX_LENGTH_RATIO * n_a) {
+        return NO_MATCH;
+    }
+
+    auto frame_dist = [&](int i, int j) {
+        const float* x = a + (size_t)i * N_MFCC;
+        const float* y = b + (size_t)j * N_MFCC;
+        float sum = 0.0f;
+        for (int k = 0; k < N_MFCC; k++) {
+            const float d = x[k] - y[k];
+            sum += d * d;
+        }
+        return std::sqrt(sum);
+    };
+
+    // Symmetric steps (diagonal counts twice), so the total cost divided
+    // by n_a + n_b is the mean distance per frame. Two rows of the matrix.
+    const float inf = std::numeric_limits<float>::infinity();
+    m_cost.assign((size_t)2 * (n_b + 1), inf);
+    float* prev = m_cost.data();
+    float* cur = prev + n_b + 1;
+    prev[0] = 0.0f;
+
+    for (int i = 1; i <= n_a; i++) {
+        cur[0] = inf;
+        for (int j = 1; j <= n_b; j++) {
+            const float d = frame_dist(i - 1, j - 1);
+            cur[j] = std::min({prev[j] + d, cur[j - 1] + d, prev[j - 1] + 2.0f * d});
+        }
+        std::swap(prev, cur);
+    }
+
+    return prev[n_b] / (n_a + n_b);
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "mel_stream.h"
+
+// Template-matching keyword spotter for short control phrases.
+//
+// Each command is given one or more spoken examples (16 kHz PCM). Examples
+// and utterances are turned into MFCCs (log-mel from MelStream, DCT, mean
+// normalized over the phrase, leading/trailing silence trimmed) and compared
+// with dynamic time warping. An utterance close enough to a template is
+// handled locally, without whisper or the LLM.
+class KeywordSpotter {
+public:
+    static const int N_MEL = 40;
+    static const int N_MFCC = 13;
+
+    explicit KeywordSpotter(float threshold = 2.0f);
+
+    // Mean per-frame DTW distance below which an utterance matches
+    void set_threshold(float threshold) { m_threshold = threshold; }
+    float threshold() const { return m_threshold; }
+
+    // Add an example of command. Returns false if it holds no speech.
+    bool add_template(const std::string& command, const float* samples, size_t n_samples);
+
+    bool empty() const { return m_templates.empty(); }
+
+    // Utterances longer than this (in samples) cannot match any template
+    size_t max_samples() const { return m_max_samples; }
+
+    // Command whose template is closest to the utterance, or "" if none is
+    // within the threshold. *distance gets the best distance either way
+    // (a large value when nothing was comparable).
+    std::string match(const float* samples, size_t n_samples, float* distance = nullptr);
+
+private:
+    struct Template {
+        std::string command;
+        int n_frames;
+        std::vector<float> mfcc;  // [n_frames][N_MFCC]
+    };
+
+    // Trimmed, mean-normalized MFCCs; returns the number of frames
+    int compute_mfcc(const float* samples, size_t n_samples, std::vector<float>& mfcc);
+
+    // Length-normalized DTW distance, or a large value if the lengths are
+    // too different to be the same phrase
+    float dtw(const float* a, int n_a, const float* b, int n_b);
+
+    float m_threshold;
+    size_t m_max_samples = 0;
+
+    std::vector<Template> m_templates;
+
+    MelStream m_mel;
+    std::vector<float> m_dct;  // [N_MFCC][N_MEL], orthonormal DCT-II
+
+    // Scratch
+    std::vector<float> m_logmel;
+    std::vector<float> m_mfcc;
+    std::vector<float> m_cost;
+};
@@ -0,0 +1,225 @@
+#include "mel_stream.h"
+
+#include <cmath>
+#include <algorithm>
+
+// Reflect padding in front of the first frame (n_fft / 2)
+static const int PAD = MelStream::N_FFT / 2;
+
+// Power floor before log10, as in whisper.cpp
+static const double MIN_POWER = 1e-10;
+
+// Slaney mel scale (librosa htk=False): linear below 1 kHz, log above
+static double hz_to_mel(double f) {
+    const double f_sp = 200.0 / 3.0;
+    const double min_log_hz = 1000.0;
+    const double min_log_mel = min_log_hz / f_sp;
+    const double logstep = std::log(6.4) / 27.0;
+
+    return f >= min_log_hz ? min_log_mel + std::log(f / min_log_hz) / logstep : f / f_sp;
+}
+
+static double mel_to_hz(double m) {
+    const double f_sp = 200.0 / 3.0;
+    const double min_log_hz = 1000.0;
+    const double min_log_mel = min_log_hz / f_sp;
+    const double logstep = std::log(6.4) / 27.0;
+
+    return m >= min_log_mel ? min_log_hz * std::exp(logstep * (m - min_log_mel)) : f_sp * m;
+}
+
+MelStream::MelStream(int n_mel) : m_n_mel(n_mel) {
+    const int n_bins = N_FFT / 2 + 1;
+
+    // Periodic Hann window
+    m_hann.resize(N_FFT);
+    for (int i = 0; i < N_FFT; i++) {
+        m_hann[i] = (float)(0.5 * (1.0 - std::cos(2.0 * M_PI * i / N_FFT)));
+    }
+
+    // Triangular filters between n_mel + 2 points evenly spaced in mel,
+    // normalized to constant energy per filter (librosa norm="slaney")
+    std::vector<double> mel_f(n_mel + 2);
+    const double mel_max = hz_to_mel(SAMPLE_RATE / 2.0);
+    for (int i = 0; i < n_mel + 2; i++) {
+        mel_f[i] = mel_to_hz(mel_max * i / (n_mel + 1));
+    }
+
+    m_filters.assign((size_t)n_mel * n_bins, 0.0f);
+    for (int i = 0; i < n_mel; i++) {
+        const double enorm = 2.0 / (mel_f[i + 2] - mel_f[i]);
+        for (int k = 0; k < n_bins; k++) {
+            const double f = (double)k * SAMPLE_RATE / N_FFT;
+            const double lower = (f - mel_f[i]) / (mel_f[i + 1] - mel_f[i]);
+            const double upper = (mel_f[i + 2] - f) / (mel_f[i + 2] - mel_f[i + 1]);
+            m_filters[(size_t)i * n_bins + k] = (float)(std::max(0.0, std::min(lower, upper)) * enorm);
+        }
+    }
+
+    m_twiddles.resize(N_FFT);
+    for (int k = 0; k < N_FFT; k++) {
+        const double phi = -2.0 * M_PI * k / N_FFT;
+        m_twiddles[k] = cpx((float)std::cos(phi), (float)std::sin(phi));
+    }
+
+    // The real N_FFT-point transform runs as a complex one of half the size
+    size_t n = N_FFT / 2;
+    for (size_t radix : {2, 5}) {
+        while (n % radix == 0) {
+            m_factors.push_back(radix);
+            n /= radix;
+        }
+    }
+
+    m_frame.resize(N_FFT);
+    m_fft_in.resize(N_FFT / 2);
+    m_fft_out.resize(N_FFT / 2);
+    m_power.resize(n_bins);
+}
+
+void MelStream::reset() {
+    m_raw.clear();
+    m_frames.clear();
+}
+
+void MelStream::fft_rec(const cpx* in, cpx* out, size_t n, size_t stride, size_t i_factor, size_t tw_stride) {
+    if (n == 1) {
+        out[0] = in[0];
+        return;
+    }
+
+    // Decimation in time: p interleaved sub-transforms of size m
+    const size_t p = m_factors[i_factor];
+    const size_t m = n / p;
+
+    for (size_t r = 0; r < p; r++) {
+        fft_rec(in + r * stride, out + r * m, m, stride * p, i_factor + 1, tw_stride * p);
+    }
+
+    cpx y[5];
+    for (size_t k = 0; k < m; k++) {
+        for (size_t r = 0; r < p; r++) {
+            y[r] = out[r * m + k] * m_twiddles[r * k * tw_stride];
+        }
+        for (size_t q = 0; q < p; q++) {
+            cpx sum = y[0];
+            for (size_t r = 1; r < p; r++) {
+                sum += y[r] * m_twiddles[((r * q) % p) * m * tw_stride];
+            }
+            out[k + q * m] = sum;
+        }
+    }
+}
+
+void MelStream::fft_half(const cpx* in, cpx* out) {
+    // Twiddles are stored for N_FFT; the half-size transform uses every other one
+    fft_rec(in, out, N_FFT / 2, 1, 0, 2);
+}
+
+void MelStream::compute_frame(const float* frame, float* out) {
+    const int n_half = N_FFT / 2;
+    const int n_bins = N_FFT / 2 + 1;
+
+    // Pack even/odd samples as real/imaginary parts
+    for (int i = 0; i < n_half; i++) {
+        m_fft_in[i] = cpx(frame[2 * i] * m_hann[2 * i], frame[2 * i + 1] * m_hann[2 * i + 1]);
+    }
+
+    fft_half(m_fft_in.data(), m_fft_out.data());
+
+    // Split into the spectra of the even and odd samples and combine
+    for (int k = 0; k < n_bins; k++) {
+        const cpx zk = m_fft_out[k % n_half];
+        const cpx zc = std::conj(m_fft_out[(n_half - k) % n_half]);
+        const cpx even = 0.5f * (zk + zc);
+        const cpx odd = cpx(0.0f, -0.5f) * (zk - zc);
+        m_power[k] = std::norm(even + m_twiddles[k] * odd);
+    }
+
+    for (int j = 0; j < m_n_mel; j++) {
+        const float* filter = m_filters.data() + (size_t)j * n_bins;
+        double sum = 0.0;
+        for (int k = 0; k < n_bins; k++) {
+            sum += filter[k] * m_power[k];
+        }
+        out[j] = (float)std::log10(std::max(sum, MIN_POWER));
+    }
+}
+
+float MelStream::padded_sample(uint64_t p, uint64_t n_valid) const {
+    // Padded samples before PAD mirror the start without repeating sample 0
+    const uint64_t i = p < (uint64_t)PAD ? PAD - p : p - PAD;
+    return i < n_valid ? m_raw[i] : 0.0f;
+}
+
+void MelStream::append_frame(size_t i, uint64_t n_valid) {
+    const uint64_t p0 = (uint64_t)i * HOP;
+    for (int k = 0; k < N_FFT; k++) {
+        m_frame[k] = padded_sample(p0 + k, n_valid);
+    }
+
+    m_frames.resize(m_frames.size() + m_n_mel);
+    compute_frame(m_frame.data(), m_frames.data() + m_frames.size() - m_n_mel);
+}
+
+void MelStream::push(const float* samples, size_t n_samples) {
+    m_raw.insert(m_raw.end(), samples, samples + n_samples);
+
+    // The reflect padding needs sample PAD; frame i needs samples up to
+    // i * HOP + N_FFT - PAD
+    const uint64_t n_raw = m_raw.size();
+    if (n_raw <= (uint64_t)PAD) {
+        return;
+    }
+
+    while ((uint64_t)n_frames() * HOP + N_FFT - PAD <= n_raw) {
+        append_frame(n_frames(), n_raw);
+    }
+}
+
+int MelStream::finish(uint64_t n_total, int min_len, std::vector<float>& mel) {
+    n_total = std::min<uint64_t>(n_total, m_raw.size());
+
+    // Frames whisper considers part of the audio
+    const int n_len_org = n_total + PAD >= (uint64_t)N_FFT ? 1 + (int)((n_total + PAD - N_FFT) / HOP) : 1;
+
+    // Frames that still see real audio; everything after is digital silence
+    const size_t n_audio_frames = (size_t)((n_total + PAD + HOP - 1) / HOP);
+
+    const int n_len = std::max(n_len_org, min_len);
+
+    // Keep only frames that ended before the new end; the rest (and all of
+    // them if the utterance is too short for the reflect padding) are redone
+    size_t n_keep = 0;
+    if (n_total > (uint64_t)PAD) {
+        n_keep = std::min<size_t>(n_frames(), (size_t)((n_total + PAD - N_FFT) / HOP + 1));
+    }
+    m_frames.resize(n_keep * m_n_mel);
+
+    // Remaining frames with zero padding past the end. whisper takes the
+    // maximum over its padded spectrogram, which includes all of these even
+    // when n_len cuts some off.
+    while (n_frames() < n_audio_frames) {
+        append_frame(n_frames(), n_total);
+    }
+
+    float mmax = (float)std::log10(MIN_POWER);
+    for (float v : m_frames) {
+        mmax = std::max(mmax, v);
+    }
+    const float floor = mmax - 8.0f;
+
+    // Silence frames are log10(MIN_POWER), which always sits on the clamp
+    const float silence = (std::max((float)std::log10(MIN_POWER), floor) + 4.0f) / 4.0f;
+
+    mel.assign((size_t)m_n_mel * n_len, silence);
+    const size_t n_copy = std::min<size_t>(n_frames(), n_len);
+    for (size_t i = 0; i < n_copy; i++) {
+        const float* frame = m_frames.data() + i * m_n_mel;
+        for (int j = 0; j < m_n_mel; j++) {
+            mel[(size_t)j * n_len + i] = (std::max(frame[j], floor) + 4.0f) / 4.0f;
+        }
+    }
+
+    return n_len;
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <complex>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Whisper-compatible log-mel spectrogram computed while audio arrives.
+//
+// whisper_full() normally computes the whole spectrogram from the PCM after
+// the player has stopped talking. MelStream computes each 25 ms frame once,
+// as soon as its samples are in, so at the endpoint only the last few
+// frames and the global normalization are left. The result goes to
+// whisper_set_mel().
+//
+// Matches whisper.cpp's front-end: 16 kHz, 400-point periodic Hann window,
+// hop 160, reflect padding of 200 samples at the start, Slaney mel filters,
+// log10 clamped to 8 below the maximum and scaled as (x + 4) / 4.
+class MelStream {
+public:
+    static const int SAMPLE_RATE = 16000;
+    static const int N_FFT = 400;
+    static const int HOP = 160;
+
+    explicit MelStream(int n_mel = 80);
+
+    int n_mel() const { return m_n_mel; }
+
+    // Start a new utterance
+    void reset();
+
+    // Append audio and compute every frame that is now complete
+    void push(const float* samples, size_t n_samples);
+
+    // Samples pushed since reset()
+    uint64_t n_samples() const { return m_raw.size(); }
+
+    // Frames computed so far
+    size_t n_frames() const { return m_frames.size() / m_n_mel; }
+
+    // End the utterance after n_total samples (may be fewer than were
+    // pushed; frames reaching past it are recomputed with zero padding).
+    // Writes the normalized spectrogram in whisper's [n_mel][n_len] layout,
+    // padded with silence frames to at least min_len frames. Returns n_len.
+    int finish(uint64_t n_total, int min_len, std::vector<float>& mel);
+
+    // Mel filterbank ([n_mel][N_FFT / 2 + 1], Slaney scale and norm)
+    const std::vector<float>& filters() const { return m_filters; }
+
+    // Log10 mel energies of one frame of N_FFT samples (the Hann window is
+    // applied here), before normalization
+    void compute_frame(const float* frame, float* out);
+
+private:
+    using cpx = std::complex<float>;
+
+    // Complex FFT of size N_FFT / 2, mixed radix (2 and 5)
+    void fft_half(const cpx* in, cpx* out);
+    void fft_rec(const cpx* in, cpx* out, size_t n, size_t stride, size_t i_factor, size_t tw_stride);
+
+    // Sample p of the reflect-padded signal, zero past the first n_valid
+    // samples of the utterance
+    float padded_sample(uint64_t p, uint64_t n_valid) const;
+
+    // Window padded frame i and append its mel energies
+    void append_frame(size_t i, uint64_t n_valid);
+
+    int m_n_mel;
+
+    std::vector<float> m_hann;
+    std::vector<float> m_filters;
+    std::vector<cpx> m_twiddles;      // exp(-2 pi i k / N_FFT)
+    std::vector<size_t> m_factors;    // radices of N_FFT / 2
+
+    // Scratch
+    std::vector<float> m_frame;
+    std::vector<cpx> m_fft_in;
+    std::vector<cpx> m_fft_out;
+    std::vector<float> m_power;
+
+    std::vector<float> m_frames;      // [n_frames][n_mel]
+
+    // Samples of the utterance, kept so finish() can end it earlier
+    std::vector<float> m_raw;
+};
@@ -1,33 +1,84 @@
 #include "npc_chat.h"
-#include <curl/curl.h>
-#include <sstream>
+#include "json_extract.h"
+#include "sse_parser.h"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
 #include <iostream>
+#include <random>
+#include <thread>
+#include <cstdio>
 #include <cstdlib>
 
-static size_t WriteCallback(void* contents, size_t size, size_t nmemb, std::string* userp) {
-    userp->append((char*)contents, size * nmemb);
-    return size * nmemb;
+const char* const DEFAULT_CHAT_URL = "https://openrouter.ai/api/v1/chat/completions";
+
+static const char* const CHAT_MODEL = "anthropic/claude-3-haiku";
+
+const char* const FALLBACK_REPLY = "Hmm, I didn't quite catch that.";
+
+// Replies timed for latencyP95Ms()
+static const size_t LATENCY_SAMPLES = 100;
+
+// Rough token count (about 4 characters per token in English)
+static size_t estimateTokens(const std::string& text) {
+    return text.size() / 4 + 1;
 }
 
-// Escape special characters for JSON string
-static std::string escapeJson(const std::string& str) {
-    std::string result;
-    result.reserve(str.size() * 2);
+// Append str to out, escaped for a JSON string
+static void appendEscaped(std::string& out, const std::string& str) {
     for (char c : str) {
         switch (c) {
-            case '"':  result += "\\\""; break;
-            case '\\': result += "\\\\"; break;
-            case '\n': result += "\\n"; break;
-            case '\r': result += "\\r"; break;
-            case '\t': result += "\\t"; break;
-            default:   result += c; break;
+            case '"':  out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                if ((unsigned char)c < 0x20) {
+                    char escaped[8];
+                    snprintf(escaped, sizeof(escaped), "\\u%04x", (unsigned char)c);
+                    out += escaped;
+                } else {
+                    out += c;
+                }
+                break;
         }
     }
-    return result;
+}
+
+// Append {"role":...,"content":...}
+static void appendMessage(std::string& out, const std::string& role, const std::string& content) {
+    out += "{\"role\":\"";
+    out += role;
+    out += "\",\"content\":\"";
+    appendEscaped(out, content);
+    out += "\"}";
+}
+
+// Like appendMessage, marking the end of the content as a prompt cache
+// breakpoint (Anthropic's cache_control, passed through by OpenRouter)
+static void appendCachedMessage(std::string& out, const std::string& role, const std::string& content) {
+    out += "{\"role\":\"";
+    out += role;
+    out += "\",\"content\":[{\"type\":\"text\",\"text\":\"";
+    appendEscaped(out, content);
+    out += "\",\"cache_control\":{\"type\":\"ephemeral\"}}]}";
+}
+
+bool NPCChat::parseCompletion(const std::string& response, std::string& content) {
+    JsonExtractor parser({"choices.0.message.content"});
+    if (!parser.feed(response) || !parser.complete() || parser.value().empty()) {
+        std::cerr << "Failed to parse response: " << response.substr(0, 1024) << std::endl;
+        return false;
+    }
+
+    content = parser.value();
+    return true;
 }
 
 NPCChat::NPCChat(const std::string& apiKey, const std::string& npcName)
     : m_apiKey(apiKey), m_npcName(npcName) {
+    setEndpoint(DEFAULT_CHAT_URL);
 
     m_systemPrompt =
         "CRITICAL: Your response must contain ONLY spoken words. "
@@ -42,156 +93,662 @@ NPCChat::NPCChat(const std::string& apiKey, const std::string& npcName)
         "- Never break the fourth wall\n"
         "- Never mention being an AI\n"
         "- React naturally to player questions about quests, directions, or lore";
+    rebuildMessagesJson();
 }
 
 NPCChat::NPCChat(const std::string& apiKey, const NPCConfig& config)
-    : m_apiKey(apiKey), m_npcName(config.name) {
-    m_systemPrompt = config.buildPrompt();
+    : NPCChat(apiKey, config, DEFAULT_CHAT_URL) {
+}
+
+NPCChat::NPCChat(const std::string& apiKey, const NPCConfig& config, const std::string& url,
+                 const std::string& caBundle, Transport transport)
+    : m_apiKey(apiKey), m_npcName(config.name), m_transport(std::move(transport)) {
+    setEndpoint(url, caBundle);
+    m_systemPrompt = config.buildStaticPrompt();
+    m_situation = config.buildDynamicPrompt();
+    rebuildMessagesJson();
+}
+
+NPCChat::~NPCChat() {
+    std::lock_guard<std::mutex> lock(m_callsMutex);
+    for (std::future<void>& call : m_calls) {
+        call.wait();
+    }
+
+    m_summaryCancel = true;
+    if (m_summary.valid()) {
+        m_summary.wait();
+    }
+}
+
+void NPCChat::setEndpoint(const std::string& url, const std::string& caBundle) {
+    std::lock_guard<std::mutex> lock(m_httpMutex);
+    m_httpConfig.url = url;
+    m_httpConfig.caBundle = caBundle;
+    m_httpConfig.headers = {
+        "Content-Type: application/json",
+        "Authorization: Bearer " + m_apiKey,
+    };
+    m_http.reset();
+}
+
+HttpClient& NPCChat::http() {
+    std::lock_guard<std::mutex> lock(m_httpMutex);
+    if (!m_http) {
+        m_http.reset(new HttpClient(m_httpConfig));
+    }
+    return *m_http;
+}
+
+void NPCChat::setTransport(Transport transport) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_transport = std::move(transport);
 }
 
 void NPCChat::setConfig(const NPCConfig& config) {
+    std::lock_guard<std::mutex> lock(m_mutex);
     m_npcName = config.name;
-    m_systemPrompt = config.buildPrompt();
+    m_systemPrompt = config.buildStaticPrompt();
+    m_situation = config.buildDynamicPrompt();
+    rebuildMessagesJson();
+}
+
+void NPCChat::setSituation(const std::string& situation) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_situation = situation;
+}
+
+void NPCChat::setPromptCaching(bool enabled) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_promptCaching = enabled;
+    rebuildMessagesJson();
 }
 
 void NPCChat::setPersonality(const std::string& personality) {
+    std::lock_guard<std::mutex> lock(m_mutex);
     m_systemPrompt = personality;
+    m_situation.clear();
+    rebuildMessagesJson();
+}
+
+void NPCChat::setHistoryPolicy(const NPCHistoryPolicy& policy) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_policy = policy;
+    trimHistory();
+}
+
+void NPCChat::setRequestPolicy(const NPCRequestPolicy& policy) {
+    std::lock_guard<std::mutex> lock(m_statsMutex);
+    m_requestPolicy = policy;
+}
+
+long NPCChat::latencyP95Ms(size_t minSamples) {
+    std::vector<long> latencies;
+    {
+        std::lock_guard<std::mutex> lock(m_statsMutex);
+        if (m_latencies.empty() || m_latencies.size() < minSamples) {
+            return 0;
+        }
+        latencies.assign(m_latencies.begin(), m_latencies.end());
+    }
+
+    const size_t index = (latencies.size() * 95 + 99) / 100 - 1;
+    std::nth_element(latencies.begin(), latencies.begin() + index, latencies.end());
+    return latencies[index];
 }
 
 void NPCChat::clearHistory() {
+    std::lock_guard<std::mutex> lock(m_mutex);
     m_history.clear();
+    m_historySizes.clear();
+    m_historyTokens = 0;
+    m_memory.clear();
+    m_toSummarize.clear();
+    m_historyGeneration++;  // a summary in progress is dropped
+    m_messagesJson.clear();
+    m_historyStart = 0;
+    rebuildMessagesJson();
+}
+
+std::string NPCChat::getMemory() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_memory;
+}
+
+std::string NPCChat::chat(const std::string& playerMessage) {
+    std::string npcResponse;
+    if (!complete(playerMessage, npcResponse)) {
+        commitFailedTurn(playerMessage);
+        return FALLBACK_REPLY;
+    }
+
+    commitTurn(playerMessage, npcResponse);
+    return npcResponse;
+}
+
+// One request of a chatAsync() call
+struct ChatAttempt {
+    std::atomic_bool cancel{false};
+    std::string response;
+    long status = 0;
+    bool ok = false;
+    long latencyMs = 0;
+};
+
+static long elapsedMs(std::chrono::steady_clock::time_point since) {
+    return (long)std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - since).count();
+}
+
+// Transport errors (no status), timeouts, rate limits and server errors may
+// pass; client errors (bad key, bad request) will not get better
+static bool isRetryable(long status) {
+    return status == 0 || status == 408 || status == 429 || status >= 500;
+}
+
+// Before attempt + 1: exponential backoff with +-25% jitter, so many NPCs
+// do not retry in lockstep
+static std::chrono::milliseconds backoffDelay(const NPCRequestPolicy& policy, int attempt) {
+    static thread_local std::minstd_rand rng(std::random_device{}());
+    std::uniform_real_distribution<double> jitter(0.75, 1.25);
+    return std::chrono::milliseconds((long)(policy.backoffMs * (double)(1L << (attempt - 1)) * jitter(rng)));
 }
 
-// Find closing quote, skipping escaped quotes
-static size_t findClosingQuote(const std::string& s, size_t start) {
-    for (size_t i = start; i < s.size(); i++) {
-        if (s[i] == '"') {
-            // Check if this quote is escaped (count preceding backslashes)
-            size_t backslashes = 0;
-            size_t j = i;
-            while (j > start && s[j - 1] == '\\') {
-                backslashes++;
-                j--;
+// The limits of one attempt: what is left of the deadline
+static HttpTimeouts attemptTimeouts(const NPCRequestPolicy& policy, std::chrono::steady_clock::time_point deadline) {
+    HttpTimeouts timeouts;
+    timeouts.connectTimeoutMs = policy.connectTimeoutMs;
+    timeouts.timeoutMs = std::max(1L, (long)std::chrono::duration_cast<std::chrono::milliseconds>(
+                                          deadline - std::chrono::steady_clock::now()).count());
+    return timeouts;
+}
+
+std::future<NPCReply> NPCChat::chatAsync(const std::string& playerMessage) {
+    auto promise = std::make_shared<std::promise<NPCReply>>();
+    std::future<NPCReply> reply = promise->get_future();
+
+    std::lock_guard<std::mutex> lock(m_callsMutex);
+    m_calls.erase(std::remove_if(m_calls.begin(), m_calls.end(), [](std::future<void>& call) {
+        return call.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+    }), m_calls.end());
+    m_calls.push_back(std::async(std::launch::async, &NPCChat::runChat, this, playerMessage, promise));
+
+    return reply;
+}
+
+void NPCChat::runChat(const std::string& playerMessage, const std::shared_ptr<std::promise<NPCReply>>& promise) {
+    const auto start = std::chrono::steady_clock::now();
+
+    NPCRequestPolicy policy;
+    {
+        std::lock_guard<std::mutex> lock(m_statsMutex);
+        policy = m_requestPolicy;
+    }
+    const auto deadline = start + std::chrono::milliseconds(policy.deadlineMs);
+    const long hedgeAfterMs = policy.hedge ? latencyP95Ms(std::max<size_t>(policy.hedgeMinSamples, 1)) : 0;
+
+    NPCReply reply;
+
+    // Attempts run on their own threads so a slow one can be raced by a
+    // second (hedged) request; the first good reply wins
+    std::mutex doneMutex;
+    std::condition_variable done;
+    std::shared_ptr<ChatAttempt> winner;
+    int finished = 0;
+    std::vector<std::shared_ptr<ChatAttempt>> attempts;  // of the current round
+    std::vector<std::future<void>> running;
+
+    auto launch = [&]() {
+        auto attempt = std::make_shared<ChatAttempt>();
+        attempts.push_back(attempt);
+        reply.attempts++;
+        const HttpTimeouts timeouts = attemptTimeouts(policy, deadline);
+
+        running.push_back(std::async(std::launch::async, [&, attempt, timeouts]() {
+            const auto attemptStart = std::chrono::steady_clock::now();
+            std::string request = acquireBuffer();
+            buildRequestJson(playerMessage, false, request);
+            attempt->ok = requestCompletion(request, attempt->response, &attempt->cancel, &attempt->status, timeouts);
+            releaseBuffer(std::move(request));
+            attempt->latencyMs = elapsedMs(attemptStart);
+
+            std::lock_guard<std::mutex> lock(doneMutex);
+            finished++;
+            if (attempt->ok && !winner) {
+                winner = attempt;
             }
-            // If even number of backslashes, the quote is not escaped
-            if (backslashes % 2 == 0) {
-                return i;
+            done.notify_all();
+        }));
+    };
+
+    std::shared_ptr<ChatAttempt> won;
+    for (int round = 1; round <= policy.maxAttempts && std::chrono::steady_clock::now() < deadline; round++) {
+        attempts.clear();
+        int launched = 1;
+        {
+            std::lock_guard<std::mutex> lock(doneMutex);
+            finished = 0;
+        }
+        launch();
+
+        std::unique_lock<std::mutex> lock(doneMutex);
+        auto settled = [&] { return winner || finished == launched; };
+        if (hedgeAfterMs > 0 && !done.wait_for(lock, std::chrono::milliseconds(hedgeAfterMs), settled) &&
+            std::chrono::steady_clock::now() < deadline) {
+            // Slower than 95% of recent replies: race a second request
+            lock.unlock();
+            launch();
+            launched++;
+            reply.hedged = true;
+            lock.lock();
+        }
+        done.wait(lock, settled);
+        won = winner;
+        lock.unlock();
+
+        if (won) {
+            break;
+        }
+
+        bool retryable = false;
+        for (const auto& attempt : attempts) {
+            retryable = retryable || isRetryable(attempt->status);
+        }
+        if (!retryable || round == policy.maxAttempts) {
+            break;
+        }
+
+        const auto backoff = backoffDelay(policy, round);
+        if (std::chrono::steady_clock::now() + backoff >= deadline) {
+            break;
+        }
+        std::cerr << "Retrying chat request in " << backoff.count() << " ms" << std::endl;
+        std::this_thread::sleep_for(backoff);
+    }
+
+    if (won) {
+        // The other request of a hedge is no longer needed
+        for (const auto& attempt : attempts) {
+            attempt->cancel = true;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(m_statsMutex);
+            m_latencies.push_back(won->latencyMs);
+            if (m_latencies.size() > LATENCY_SAMPLES) {
+                m_latencies.pop_front();
             }
         }
+
+        commitTurn(playerMessage, won->response);
+        reply.ok = true;
+        reply.text = won->response;
+    } else {
+        commitFailedTurn(playerMessage);
+        reply.text = FALLBACK_REPLY;
+    }
+
+    reply.latencyMs = elapsedMs(start);
+    promise->set_value(reply);
+
+    // A cancelled request can take a moment to notice
+    for (std::future<void>& attempt : running) {
+        attempt.wait();
     }
-    return std::string::npos;
 }
 
-// Unescape JSON string
-static std::string unescapeJson(const std::string& s) {
-    std::string result;
-    result.reserve(s.size());
-    for (size_t i = 0; i < s.size(); i++) {
-        if (s[i] == '\\' && i + 1 < s.size()) {
-            switch (s[i + 1]) {
-                case 'n':  result += '\n'; i++; break;
-                case 'r':  result += '\r'; i++; break;
-                case 't':  result += '\t'; i++; break;
-                case '"':  result += '"';  i++; break;
-                case '\\': result += '\\'; i++; break;
-                default:   result += s[i]; break;
-            }
-        } else {
-            result += s[i];
+bool NPCChat::complete(const std::string& playerMessage, std::string& npcResponse, const std::atomic_bool* cancel) {
+    std::string request = acquireBuffer();
+    buildRequestJson(playerMessage, false, request);
+    const bool ok = requestCompletion(request, npcResponse, cancel);
+    releaseBuffer(std::move(request));
+    return ok;
+}
+
+bool NPCChat::requestCompletion(const std::string& body, std::string& content, const std::atomic_bool* cancel,
+                                long* status, const HttpTimeouts& timeouts) {
+    // The reply is parsed as it arrives rather than after buffering it
+    JsonExtractor parser({"choices.0.message.content"});
+    bool valid = true;
+    std::string head;
+    const bool sent = http().post(body, [&](const char* data, size_t size) {
+        if (head.size() < 1024) {
+            head.append(data, std::min<size_t>(size, 1024 - head.size()));
         }
+        if (valid) {
+            valid = parser.feed(data, size);
+        }
+        return true;
+    }, cancel, status, timeouts);
+
+    // Transport errors are reported by HttpClient
+    if (!sent || (cancel && *cancel)) {
+        return false;
     }
-    return result;
+
+    if (!parser.complete() || parser.value().empty()) {
+        std::cerr << "Failed to parse response: " << head << std::endl;
+        return false;
+    }
+
+    content = parser.value();
+    return true;
 }
 
-std::string NPCChat::chat(const std::string& playerMessage) {
-    m_history.push_back({"user", playerMessage});
+std::string NPCChat::chatStream(const std::string& playerMessage, const TokenCallback& onToken) {
+    std::string npcResponse;
+    if (!completeStream(playerMessage, onToken, npcResponse)) {
+        commitFailedTurn(playerMessage);
+        return FALLBACK_REPLY;
+    }
+
+    commitTurn(playerMessage, npcResponse);
+    return npcResponse;
+}
 
-    std::string json = buildRequestJson();
-    std::string response = makeRequest(json);
+bool NPCChat::completeStream(const std::string& playerMessage, const TokenCallback& onToken,
+                             std::string& npcResponse, const std::atomic_bool* cancel) {
+    const auto start = std::chrono::steady_clock::now();
 
-    // Parse response - find "content":"..." or "content": "..."
-    size_t contentStart = response.find("\"content\":\"");
-    if (contentStart == std::string::npos) {
-        contentStart = response.find("\"content\": \"");
-        if (contentStart != std::string::npos) contentStart += 12;
-    } else {
-        contentStart += 11;
+    NPCRequestPolicy policy;
+    {
+        std::lock_guard<std::mutex> lock(m_statsMutex);
+        policy = m_requestPolicy;
     }
+    const auto deadline = start + std::chrono::milliseconds(policy.deadlineMs);
+
+    std::string request = acquireBuffer();
+    buildRequestJson(playerMessage, true, request);
+
+    bool ok = false;
+    for (int attempt = 1;; attempt++) {
+        long status = 0;
+        ok = requestStream(request, onToken, npcResponse, cancel, &status, attemptTimeouts(policy, deadline));
+
+        // Once tokens went to onToken another reply can't follow them, so
+        // only a request that failed before the first one is retried
+        if (ok || !npcResponse.empty() || (cancel && *cancel) || !isRetryable(status) || attempt >= policy.maxAttempts) {
+            break;
+        }
+
+        const auto backoff = backoffDelay(policy, attempt);
+        if (std::chrono::steady_clock::now() + backoff >= deadline) {
+            break;
+        }
+        std::cerr << "Retrying chat request in " << backoff.count() << " ms" << std::endl;
+        std::this_thread::sleep_for(backoff);
+    }
+
+    releaseBuffer(std::move(request));
+    return ok;
+}
+
+bool NPCChat::requestStream(const std::string& body, const TokenCallback& onToken, std::string& npcResponse,
+                            const std::atomic_bool* cancel, long* status, const HttpTimeouts& timeouts) {
+    npcResponse.clear();
+    bool failed = false;
+    bool stopped = false;  // onToken asked to stop, which also aborts the transfer
+
+    // Each event carries the next piece of the reply in choices[0].delta.
+    // The parser is reused, so the token buffer is only allocated once.
+    JsonExtractor parser({"choices.0.delta.content", "error"});
+    SseParser sse([&](const std::string& data) {
+        if (data == "[DONE]") {
+            return true;  // the server closes the stream; the connection stays open
+        }
+
+        parser.reset();
+        parser.feed(data);
+
+        if (parser.found(1)) {
+            std::cerr << "API error: " << data << std::endl;
+            failed = true;
+            return false;
+        }
+
+        const std::string& token = parser.value();
+        if (!token.empty()) {
+            npcResponse += token;
+            if (onToken && !onToken(token)) {
+                stopped = true;
+                return false;
+            }
+        }
+        return true;
+    });
+
+    // Errors come back as a plain JSON body instead of events
+    std::string head;
+    const bool sent = http().post(body, [&](const char* data, size_t size) {
+        if (head.size() < 1024) {
+            head.append(data, std::min<size_t>(size, 1024 - head.size()));
+        }
+        return sse.feed(data, size);
+    }, cancel, status, timeouts);
 
-    if (contentStart == std::string::npos) {
-        std::cerr << "Failed to parse response: " << response << std::endl;
-        return "Hmm, I didn't quite catch that.";
+    // A connection lost mid-stream leaves a truncated reply
+    if ((!sent && !stopped) || (cancel && *cancel) || failed) {
+        return false;
     }
 
-    // Find closing quote (handling escaped quotes)
-    size_t contentEnd = findClosingQuote(response, contentStart);
-    if (contentEnd == std::string::npos) {
-        std::cerr << "Failed to find end of content: " << response << std::endl;
-        return "Hmm, I didn't quite catch that.";
+    if (npcResponse.empty()) {
+        std::cerr << "Failed to parse response: " << head << std::endl;
+        return false;
     }
 
-    std::string npcResponse = response.substr(contentStart, contentEnd - contentStart);
+    return true;
+}
 
-    // Unescape JSON string
-    npcResponse = unescapeJson(npcResponse);
+void NPCChat::commitTurn(const std::string& playerMessage, const std::string& npcResponse) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    addToHistory("user", playerMessage);
+    addToHistory("assistant", npcResponse);
+    trimHistory();
+}
 
-    m_history.push_back({"assistant", npcResponse});
-    return npcResponse;
+void NPCChat::commitFailedTurn(const std::string& playerMessage) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    addToHistory("user", playerMessage);
+    trimHistory();
 }
 
-std::string NPCChat::buildRequestJson() {
-    std::ostringstream json;
-    json << "{";
-    json << "\"model\":\"anthropic/claude-3-haiku\",";
-    json << "\"max_tokens\":100,";
-    json << "\"messages\":[";
-    json << "{\"role\":\"system\",\"content\":\"" << escapeJson(m_systemPrompt) << "\"},";
+void NPCChat::addToHistory(const std::string& role, const std::string& content) {
+    const size_t start = m_messagesJson.size();
+    appendMessage(m_messagesJson, role, content);
+    m_messagesJson += ',';
+
+    m_history.push_back({role, content});
+    m_historySizes.push_back(m_messagesJson.size() - start);
+    m_historyTokens += estimateTokens(content);
+}
 
-    for (size_t i = 0; i < m_history.size(); ++i) {
-        json << "{\"role\":\"" << m_history[i].role << "\",";
-        json << "\"content\":\"" << escapeJson(m_history[i].content) << "\"}";
-        if (i < m_history.size() - 1) json << ",";
+void NPCChat::trimHistory() {
+    size_t turns = 0;
+    for (const NPCMessage& message : m_history) {
+        if (message.role == "user") {
+            turns++;
+        }
     }
 
-    json << "]}";
-    return json.str();
+    // Drop whole turns from the front; the token budget always leaves the
+    // latest one
+    size_t drop = 0;
+    while (drop < m_history.size()) {
+        const bool overTurns = m_policy.maxTurns > 0 && turns > m_policy.maxTurns;
+        const bool overTokens = m_policy.maxTokens > 0 && m_historyTokens > m_policy.maxTokens && turns > 1;
+        if (!overTurns && !overTokens) {
+            break;
+        }
+
+        do {
+            m_historyTokens -= estimateTokens(m_history[drop].content);
+            if (m_history[drop].role == "user") {
+                turns--;
+            }
+            drop++;
+        } while (drop < m_history.size() && m_history[drop].role != "user");
+    }
+
+    if (drop > 0) {
+        if (m_policy.summarize) {
+            m_toSummarize.insert(m_toSummarize.end(), m_history.begin(), m_history.begin() + drop);
+        }
+
+        // Cut the dropped messages out of the serialized history rather
+        // than escaping the rest of it again
+        size_t bytes = 0;
+        for (size_t i = 0; i < drop; i++) {
+            bytes += m_historySizes[i];
+        }
+        m_messagesJson.erase(m_historyStart, bytes);
+
+        m_history.erase(m_history.begin(), m_history.begin() + drop);
+        m_historySizes.erase(m_historySizes.begin(), m_historySizes.begin() + drop);
+    }
+
+    startSummary();
 }
 
-std::string NPCChat::makeRequest(const std::string& jsonPayload) {
-    CURL* curl = curl_easy_init();
-    std::string response;
+void NPCChat::startSummary() {
+    if (m_toSummarize.empty()) {
+        return;
+    }
+
+    // One summary at a time; turns dropped meanwhile go into the next one
+    if (m_summaryPending ||
+        (m_summary.valid() && m_summary.wait_for(std::chrono::seconds(0)) != std::future_status::ready)) {
+        return;
+    }
 
-    if (curl) {
-        struct curl_slist* headers = nullptr;
-        headers = curl_slist_append(headers, "Content-Type: application/json");
-        std::string authHeader = "Authorization: Bearer " + m_apiKey;
-        headers = curl_slist_append(headers, authHeader.c_str());
+    std::vector<NPCMessage> messages;
+    messages.swap(m_toSummarize);
+    std::string body = buildSummaryRequest(m_memory, messages);
+    const unsigned generation = m_historyGeneration;
 
-        curl_easy_setopt(curl, CURLOPT_URL, "https://openrouter.ai/api/v1/chat/completions");
-        curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
-        curl_easy_setopt(curl, CURLOPT_POSTFIELDS, jsonPayload.c_str());
-        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
-        curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
+    if (m_transport) {
+        auto dropped = std::make_shared<std::vector<NPCMessage>>(std::move(messages));
+        m_summaryPending = true;
+        const bool queued = m_transport(std::move(body), [this, generation, dropped](bool ok, const std::string& response) {
+            std::string summary;
+            ok = ok && parseCompletion(response, summary);
 
-        // SSL CA certificate bundle for Windows
-#ifdef _WIN32
-        const char* caBundle = getenv("CURL_CA_BUNDLE");
-        if (caBundle) {
-            curl_easy_setopt(curl, CURLOPT_CAINFO, caBundle);
-        } else {
-            // Try common MSYS2 locations
-            curl_easy_setopt(curl, CURLOPT_CAINFO, "C:/msys64/usr/ssl/certs/ca-bundle.crt");
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_summaryPending = false;
+            finishSummary(generation, *dropped, ok, summary);
+        });
+        if (!queued) {
+            m_summaryPending = false;
+            finishSummary(generation, *dropped, false, std::string());
         }
-#endif
+        return;
+    }
+
+    m_summary = std::async(std::launch::async, &NPCChat::summarize, this, generation, std::move(body), std::move(messages));
+}
+
+std::string NPCChat::buildSummaryRequest(const std::string& memory, const std::vector<NPCMessage>& messages) const {
+    const std::string instructions =
+        "You maintain the memory of a conversation between a player and " + m_npcName + ", "
+        "an NPC in a fantasy game. Merge the new exchanges into the memory. Keep names, "
+        "facts, promises, requests and quest progress; drop greetings and small talk. "
+        "Reply with the updated memory only, in at most " + std::to_string(m_policy.summaryTokens * 3 / 4) + " words.";
+
+    std::string transcript = "Memory so far:\n" + (memory.empty() ? std::string("(nothing yet)") : memory) + "\n\nNew exchanges:\n";
+    for (const NPCMessage& message : messages) {
+        transcript += (message.role == "user" ? std::string("Player") : m_npcName) + ": " + message.content + "\n";
+    }
+
+    std::string body = "{\"model\":\"";
+    body += CHAT_MODEL;
+    body += "\",\"max_tokens\":" + std::to_string(m_policy.summaryTokens) + ",\"messages\":[";
+    appendMessage(body, "system", instructions);
+    body += ',';
+    appendMessage(body, "user", transcript);
+    body += "]}";
+    return body;
+}
+
+void NPCChat::summarize(unsigned generation, const std::string& body, const std::vector<NPCMessage>& messages) {
+    std::string summary;
+    const bool ok = requestCompletion(body, summary, &m_summaryCancel);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    finishSummary(generation, messages, ok, summary);
+}
 
-        CURLcode res = curl_easy_perform(curl);
-        if (res != CURLE_OK) {
-            std::cerr << "CURL error: " << curl_easy_strerror(res) << std::endl;
+void NPCChat::finishSummary(unsigned generation, const std::vector<NPCMessage>& messages, bool ok,
+                            const std::string& summary) {
+    if (generation != m_historyGeneration) {
+        return;  // history cleared meanwhile
+    }
+
+    if (ok) {
+        m_memory = summary;
+        rebuildMessagesJson();
+    } else {
+        // Retried with the next dropped turn
+        m_toSummarize.insert(m_toSummarize.begin(), messages.begin(), messages.end());
+    }
+}
+
+void NPCChat::rebuildMessagesJson() {
+    std::string prefix;
+    if (m_promptCaching) {
+        appendCachedMessage(prefix, "system", m_systemPrompt);
+    } else {
+        appendMessage(prefix, "system", m_systemPrompt);
+    }
+    prefix += ',';
+
+    if (!m_memory.empty()) {
+        appendMessage(prefix, "system", "Earlier in this conversation: " + m_memory);
+        prefix += ',';
+    }
+
+    // The history behind it is kept as serialized
+    m_messagesJson.replace(0, m_historyStart, prefix);
+    m_historyStart = prefix.size();
+}
+
+void NPCChat::buildRequestJson(const std::string& playerMessage, bool stream, std::string& json) {
+    json.clear();
+    json += "{\"model\":\"";
+    json += CHAT_MODEL;
+    json += "\",";
+    json += "\"max_tokens\":100,";
+    if (stream) {
+        json += "\"stream\":true,";
+    }
+    json += "\"messages\":[";
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        json += m_messagesJson;
+
+        // After the history, so a change of situation leaves everything
+        // before it (and the provider's cache of it) as it was
+        if (!m_situation.empty()) {
+            appendMessage(json, "system", m_situation);
+            json += ',';
         }
+    }
+
+    // The new message is not part of the history until the turn is committed
+    appendMessage(json, "user", playerMessage);
 
-        curl_slist_free_all(headers);
-        curl_easy_cleanup(curl);
+    json += "]}";
+}
+
+std::string NPCChat::acquireBuffer() {
+    std::lock_guard<std::mutex> lock(m_bufferMutex);
+    if (m_buffers.empty()) {
+        return std::string();
     }
+    std::string buffer = std::move(m_buffers.back());
+    m_buffers.pop_back();
+    return buffer;
+}
 
-    return response;
+void NPCChat::releaseBuffer(std::string&& buffer) {
+    std::lock_guard<std::mutex> lock(m_bufferMutex);
+    m_buffers.push_back(std::move(buffer));
 }
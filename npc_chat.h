@@ -1,8 +1,14 @@
 #pragma once
 
+#include <atomic>
+#include <deque>
 #include <string>
 #include <vector>
 #include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include "http_client.h"
 #include "npc_config.h"
 
 struct NPCMessage {
@@ -10,27 +16,214 @@ struct NPCMessage {
     std::string content;
 };
 
+// OpenRouter's OpenAI-compatible chat endpoint
+extern const char* const DEFAULT_CHAT_URL;
+
+// Said when the API could not be reached
+extern const char* const FALLBACK_REPLY;
+
+// How much of the conversation is sent with each request. Once a limit is
+// exceeded the oldest turns are dropped, so requests stop growing; with
+// summarize they are first folded into a short memory of the conversation
+// by a background request, which is sent along instead.
+struct NPCHistoryPolicy {
+    size_t maxTurns = 0;         // player/NPC exchanges kept word for word (0: no limit)
+    size_t maxTokens = 0;        // estimated tokens of the kept exchanges (0: no limit)
+    bool summarize = false;
+    size_t summaryTokens = 150;  // length limit of the memory
+};
+
+// Deadlines and retries for chatAsync() and the streamed calls (which
+// retry only until the first token and never hedge)
+struct NPCRequestPolicy {
+    long connectTimeoutMs = 3000;
+    long deadlineMs = 15000;      // for the whole call, retries included
+    int maxAttempts = 3;
+    long backoffMs = 250;         // before the second attempt, doubled after each (with jitter)
+    bool hedge = false;           // send a second request when the first is slower than the p95
+    size_t hedgeMinSamples = 20;  // replies timed before hedging starts
+};
+
+struct NPCReply {
+    bool ok = false;
+    std::string text;   // the reply, or a fallback line on failure
+    int attempts = 0;   // requests sent, hedges included
+    bool hedged = false;
+    long latencyMs = 0;
+};
+
 class NPCChat {
 public:
+    // Sends a request body and later calls onDone with the response body
+    // (ok is false on transport errors). Returns false, without calling
+    // onDone, if the request could not be queued. onDone must not be
+    // called from within the transport call itself.
+    using TransportCallback = std::function<void(bool ok, const std::string& response)>;
+    using Transport = std::function<bool(std::string body, TransportCallback onDone)>;
+
     // Simple constructor (backward compatible)
     NPCChat(const std::string& apiKey, const std::string& npcName = "Village Guard");
 
     // Config-based constructor
     NPCChat(const std::string& apiKey, const NPCConfig& config);
 
+    // Config-based, sending requests to url (see setEndpoint()) and
+    // background requests through transport if set (see setTransport())
+    NPCChat(const std::string& apiKey, const NPCConfig& config, const std::string& url,
+            const std::string& caBundle = "", Transport transport = nullptr);
+
+    // Waits for a summary in progress (cancelling it)
+    ~NPCChat();
+
     std::string chat(const std::string& playerMessage);
+
+    // Like chat(), without blocking: the reply arrives through the future.
+    // Requests are retried with exponential backoff on transport errors,
+    // 408, 429 and 5xx until the deadline (see setRequestPolicy()). Start
+    // one call at a time per NPC to keep the history in order, and keep the
+    // NPCChat alive until the future is ready.
+    std::future<NPCReply> chatAsync(const std::string& playerMessage);
+
+    // Get a reply to playerMessage without changing the history, e.g. to
+    // answer a partial transcript speculatively. Setting *cancel aborts the
+    // request. Returns false on failure or cancellation. Safe to call from
+    // another thread while chat()/commitTurn() run.
+    bool complete(const std::string& playerMessage, std::string& response, const std::atomic_bool* cancel = nullptr);
+
+    // Called with each piece of the reply as it arrives; return false to
+    // stop receiving
+    using TokenCallback = std::function<bool(const std::string& token)>;
+
+    // Like chat(), but the reply is streamed: onToken gets each piece as
+    // soon as the server sends it. Returns the whole reply. A request that
+    // fails before the first piece is retried as chatAsync() does; one
+    // that fails after it is not, and chatStream() returns the fallback
+    // line.
+    std::string chatStream(const std::string& playerMessage, const TokenCallback& onToken);
+
+    // Like complete(), streamed
+    bool completeStream(const std::string& playerMessage, const TokenCallback& onToken,
+                        std::string& response, const std::atomic_bool* cancel = nullptr);
+
+    // Record a finished exchange (e.g. after complete())
+    void commitTurn(const std::string& playerMessage, const std::string& npcResponse);
+
+    // Record a player line that got no reply, as chat() does on failure
+    void commitFailedTurn(const std::string& playerMessage);
+
+    // The body of a (non-streamed) request for playerMessage, for sending
+    // it some other way, e.g. through NPCChatHub. Doesn't change the history.
+    void buildRequest(const std::string& playerMessage, std::string& body) {
+        buildRequestJson(playerMessage, false, body);
+    }
+
+    // Send requests to url (e.g. a local stand-in for testing), trusting the
+    // CA certificates in caBundle if given. Call before chatting.
+    void setEndpoint(const std::string& url, const std::string& caBundle = "");
+
+    // Send background requests (summaries) through transport, e.g. an
+    // HttpMultiClient loop, instead of a thread of their own. The transport
+    // must not call back after the NPCChat is destroyed.
+    void setTransport(Transport transport);
+
     void setPersonality(const std::string& personality);
+    // Sets the static prompt and the situation (NPCConfig::buildStaticPrompt
+    // and buildDynamicPrompt)
     void setConfig(const NPCConfig& config);
+
+    // Replace only the volatile part of the prompt (time, weather, mood...),
+    // e.g. with NPCConfig::buildDynamicPrompt(). It is sent after the
+    // history, so the static prompt and history stay cacheable.
+    void setSituation(const std::string& situation);
+
+    // Mark the static prompt with cache_control so providers that support
+    // it (Anthropic via OpenRouter) cache it between requests
+    void setPromptCaching(bool enabled);
+    void setHistoryPolicy(const NPCHistoryPolicy& policy);
+    void setRequestPolicy(const NPCRequestPolicy& policy);
+
+    // 95th percentile latency of recent replies in ms, 0 with fewer than
+    // minSamples
+    long latencyP95Ms(size_t minSamples = 1);
     void clearHistory();
 
+    // Summary of the turns dropped from the history so far
+    std::string getMemory();
+
     const std::string& getName() const { return m_npcName; }
 
+    // The reply text of a complete (non-streamed) response body; reports
+    // and returns false if there is none
+    static bool parseCompletion(const std::string& response, std::string& content);
+
 private:
     std::string m_apiKey;
     std::string m_npcName;
-    std::string m_systemPrompt;
+    std::string m_systemPrompt;  // static part
+    std::string m_situation;     // dynamic part
+    bool m_promptCaching = false;
     std::vector<NPCMessage> m_history;
+    std::mutex m_mutex;  // guards the prompt, history and memory
+
+    NPCHistoryPolicy m_policy;
+    size_t m_historyTokens = 0;  // estimated, of m_history
+    std::string m_memory;        // summary of dropped turns
+
+    // Dropped turns waiting to be summarized, and the summary request
+    std::vector<NPCMessage> m_toSummarize;
+    std::future<void> m_summary;
+    std::atomic_bool m_summaryCancel{false};
+    bool m_summaryPending = false;  // sent through m_transport
+    Transport m_transport;
+    unsigned m_historyGeneration = 0;  // changes when the history is cleared
+
+    // The system prompt and history already serialized as JSON messages,
+    // each followed by ','. Messages are escaped once, when added, so a
+    // request only copies this and appends the new message.
+    std::string m_messagesJson;
+    size_t m_historyStart = 0;          // where m_history begins in it
+    std::vector<size_t> m_historySizes;  // serialized size of each message
+
+    // Request bodies, kept to reuse their memory (requests may run
+    // concurrently, e.g. a speculative one)
+    std::vector<std::string> m_buffers;
+    std::mutex m_bufferMutex;
+
+    // Keeps the connection to the API open between turns. Created by the
+    // first request that needs it, so an NPC whose requests all go through
+    // a transport never opens one.
+    HttpClientConfig m_httpConfig;
+    std::unique_ptr<HttpClient> m_http;
+    std::mutex m_httpMutex;
+    HttpClient& http();
+
+    NPCRequestPolicy m_requestPolicy;
+    std::deque<long> m_latencies;  // ms, most recent last
+    std::mutex m_statsMutex;       // guards m_requestPolicy and m_latencies
+    std::vector<std::future<void>> m_calls;  // chatAsync() workers
+    std::mutex m_callsMutex;
+
+    // Caller holds m_mutex (also for the summary helpers below)
+    void addToHistory(const std::string& role, const std::string& content);
+    void trimHistory();
+    void startSummary();
+    void rebuildMessagesJson();  // the part before the history
+
+    std::string buildSummaryRequest(const std::string& memory, const std::vector<NPCMessage>& messages) const;
+    void summarize(unsigned generation, const std::string& body, const std::vector<NPCMessage>& messages);
+    void finishSummary(unsigned generation, const std::vector<NPCMessage>& messages, bool ok, const std::string& summary);
+
+    void runChat(const std::string& playerMessage, const std::shared_ptr<std::promise<NPCReply>>& promise);
+
+    // Send a non-streaming request and get the reply text
+    bool requestCompletion(const std::string& body, std::string& content, const std::atomic_bool* cancel,
+                           long* status = nullptr, const HttpTimeouts& timeouts = HttpTimeouts());
+
+    // One attempt of completeStream()
+    bool requestStream(const std::string& body, const TokenCallback& onToken, std::string& npcResponse,
+                       const std::atomic_bool* cancel, long* status, const HttpTimeouts& timeouts);
 
-    std::string makeRequest(const std::string& jsonPayload);
-    std::string buildRequestJson();
+    void buildRequestJson(const std::string& playerMessage, bool stream, std::string& json);
+    std::string acquireBuffer();
+    void releaseBuffer(std::string&& buffer);
 };
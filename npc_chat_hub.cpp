@@ -0,0 +1,131 @@
+#include "npc_chat_hub.h"
+
+static HttpClientConfig hubConfig(const std::string& apiKey, const std::string& url, const std::string& caBundle) {
+    HttpClientConfig config;
+    config.url = url;
+    config.caBundle = caBundle;
+    config.headers = {
+        "Content-Type: application/json",
+        "Authorization: Bearer " + apiKey,
+    };
+    return config;
+}
+
+NPCChatHub::NPCChatHub(const std::string& apiKey, const std::string& url, const std::string& caBundle, long maxConnections)
+    : m_apiKey(apiKey), m_caBundle(caBundle), m_http(hubConfig(apiKey, url, caBundle), maxConnections) {
+}
+
+NPCChatHub::SessionId NPCChatHub::addSession(const NPCConfig& config) {
+    // Its summaries share the event loop instead of taking a thread each.
+    // Direct calls on the NPC go to the same server (over a client of its
+    // own, created only if they are made).
+    NPCChat::Transport transport = [this](std::string body, NPCChat::TransportCallback onDone) {
+        return m_http.post(std::move(body), [onDone](bool ok, long, std::string& response) {
+            onDone(ok, response);
+        });
+    };
+
+    std::unique_ptr<Session> session(new Session());
+    session->npc.reset(new NPCChat(m_apiKey, config, m_http.url(), m_caBundle, std::move(transport)));
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_sessions.push_back(std::move(session));
+    return m_sessions.size() - 1;
+}
+
+NPCChat& NPCChatHub::session(SessionId id) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return *m_sessions.at(id)->npc;
+}
+
+void NPCChatHub::send(SessionId id, const std::string& playerMessage) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Session& session = *m_sessions.at(id);
+
+    if (session.busy) {
+        session.outbox.push_back(playerMessage);
+    } else {
+        start(session, playerMessage);
+    }
+}
+
+bool NPCChatHub::poll(SessionId id, NPCReply& reply) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Session& session = *m_sessions.at(id);
+
+    if (session.replies.empty()) {
+        return false;
+    }
+    reply = std::move(session.replies.front());
+    session.replies.pop_front();
+    return true;
+}
+
+bool NPCChatHub::wait(SessionId id, NPCReply& reply, long timeoutMs) {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    Session& session = *m_sessions.at(id);
+
+    if (!session.replied.wait_for(lock, std::chrono::milliseconds(timeoutMs), [&session] { return !session.replies.empty(); })) {
+        return false;
+    }
+    reply = std::move(session.replies.front());
+    session.replies.pop_front();
+    return true;
+}
+
+void NPCChatHub::start(Session& session, const std::string& playerMessage) {
+    session.busy = true;
+
+    std::string body;
+    session.npc->buildRequest(playerMessage, body);
+
+    Session* target = &session;
+    const auto sent = std::chrono::steady_clock::now();
+    const bool queued = m_http.post(std::move(body), [this, target, playerMessage, sent](bool ok, long, std::string& response) {
+        finish(*target, playerMessage, sent, ok, response);
+    });
+
+    if (!queued) {
+        // No event loop: this and every line waiting behind it fail
+        session.npc->commitFailedTurn(playerMessage);
+        for (const std::string& line : session.outbox) {
+            session.npc->commitFailedTurn(line);
+        }
+        for (size_t i = 0; i <= session.outbox.size(); i++) {
+            NPCReply reply;
+            reply.text = FALLBACK_REPLY;
+            session.replies.push_back(reply);
+        }
+        session.outbox.clear();
+        session.busy = false;
+        session.replied.notify_all();
+    }
+}
+
+void NPCChatHub::finish(Session& session, const std::string& playerMessage, std::chrono::steady_clock::time_point sent,
+                        bool ok, const std::string& response) {
+    NPCReply reply;
+    reply.attempts = 1;
+    reply.latencyMs = (long)std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - sent).count();
+
+    std::string content;
+    if (ok && NPCChat::parseCompletion(response, content)) {
+        session.npc->commitTurn(playerMessage, content);
+        reply.ok = true;
+        reply.text = std::move(content);
+    } else {
+        session.npc->commitFailedTurn(playerMessage);
+        reply.text = FALLBACK_REPLY;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    session.replies.push_back(std::move(reply));
+    session.replied.notify_all();
+
+    session.busy = false;
+    if (!session.outbox.empty()) {
+        const std::string next = std::move(session.outbox.front());
+        session.outbox.pop_front();
+        start(session, next);
+    }
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <condition_variable>
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "http_client.h"
+#include "npc_chat.h"
+
+// Chat client for a server process that drives many NPCs at once.
+//
+// Each session is an NPC with its own prompt and history (an NPCChat), but
+// all requests, history summaries included, go through one HttpMultiClient:
+// a single event loop thread multiplexes them over a few pooled connections
+// instead of blocking a thread per conversation. Replies are delivered to per-session queues and
+// picked up with poll() or wait().
+//
+// A session sends one request at a time: lines sent while a reply is
+// pending are queued, so each request includes the previous exchange.
+class NPCChatHub {
+public:
+    using SessionId = size_t;
+
+    NPCChatHub(const std::string& apiKey, const std::string& url = DEFAULT_CHAT_URL,
+               const std::string& caBundle = "", long maxConnections = 8);
+
+    SessionId addSession(const NPCConfig& config);
+
+    // The session's NPC, e.g. for setSituation() or setHistoryPolicy()
+    NPCChat& session(SessionId id);
+
+    // Queue a player line for the NPC
+    void send(SessionId id, const std::string& playerMessage);
+
+    // Take the next reply if there is one
+    bool poll(SessionId id, NPCReply& reply);
+
+    // Wait up to timeoutMs for the next reply
+    bool wait(SessionId id, NPCReply& reply, long timeoutMs);
+
+    // Requests queued or in flight, over all sessions
+    size_t pending() const { return m_http.pending(); }
+
+private:
+    struct Session {
+        std::unique_ptr<NPCChat> npc;
+        std::deque<std::string> outbox;  // waiting for the reply in flight
+        bool busy = false;
+        std::deque<NPCReply> replies;
+        std::condition_variable replied;
+    };
+
+    // Caller holds m_mutex
+    void start(Session& session, const std::string& playerMessage);
+
+    void finish(Session& session, const std::string& playerMessage, std::chrono::steady_clock::time_point sent,
+                bool ok, const std::string& response);
+
+    std::string m_apiKey;
+    std::string m_caBundle;
+    std::mutex m_mutex;
+    std::vector<std::unique_ptr<Session>> m_sessions;
+
+    // Declared last so its loop stops before the sessions go away
+    HttpMultiClient m_http;
+};
@@ -41,6 +41,18 @@ struct NPCConfig {
 
     // Build the system prompt from all components
     std::string buildPrompt() const {
+        std::string prompt = buildStaticPrompt();
+        const std::string situation = buildDynamicPrompt();
+        if (!situation.empty()) {
+            prompt += "\n" + situation;
+        }
+        return prompt;
+    }
+
+    // The part of the prompt that stays the same from turn to turn (world,
+    // persona, knowledge, quests, rules). Sent first and unchanged, so the
+    // provider can cache it.
+    std::string buildStaticPrompt() const {
         std::string prompt;
 
         // CRITICAL OUTPUT FORMAT - put at very top for emphasis
@@ -54,13 +66,6 @@ struct NPCConfig {
         prompt += "World: " + worldName + "\n";
         prompt += worldDescription + "\n";
         prompt += "Location: " + currentLocation + " - " + locationDescription + "\n";
-        if (!currentTime.empty()) prompt += "Time: " + currentTime + "\n";
-        if (!currentWeather.empty()) prompt += "Weather: " + currentWeather + "\n";
-        if (!recentEvents.empty()) {
-            prompt += "Recent events: ";
-            for (const auto& e : recentEvents) prompt += e + "; ";
-            prompt += "\n";
-        }
 
         // Character
         prompt += "\n=== CHARACTER ===\n";
@@ -68,8 +73,6 @@ struct NPCConfig {
         prompt += "Personality: " + personality + "\n";
         prompt += "Speech style: " + speechStyle + "\n";
         if (!backstory.empty()) prompt += "Background: " + backstory + "\n";
-        if (!currentActivity.empty()) prompt += "Currently: " + currentActivity + "\n";
-        if (!currentMood.empty()) prompt += "Mood: " + currentMood + "\n";
 
         // Knowledge
         if (!knownTopics.empty()) {
@@ -107,6 +110,26 @@ struct NPCConfig {
 
         return prompt;
     }
+
+    // The volatile part (time, weather, events, activity, mood); empty if
+    // none are set
+    std::string buildDynamicPrompt() const {
+        std::string prompt;
+        if (!currentTime.empty()) prompt += "Time: " + currentTime + "\n";
+        if (!currentWeather.empty()) prompt += "Weather: " + currentWeather + "\n";
+        if (!recentEvents.empty()) {
+            prompt += "Recent events: ";
+            for (const auto& e : recentEvents) prompt += e + "; ";
+            prompt += "\n";
+        }
+        if (!currentActivity.empty()) prompt += "Currently: " + currentActivity + "\n";
+        if (!currentMood.empty()) prompt += "Mood: " + currentMood + "\n";
+
+        if (prompt.empty()) {
+            return prompt;
+        }
+        return "=== RIGHT NOW ===\n" + prompt;
+    }
 };
 
 // Example: Create a guard NPC
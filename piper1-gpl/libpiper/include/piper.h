@@ -23,6 +23,7 @@ extern "C" {
 
 #define PIPER_OK 0
 #define PIPER_DONE 1
+#define PIPER_NEED_MORE_TEXT 2
 #define PIPER_ERR_GENERIC -1
 
 /**
@@ -153,6 +154,53 @@ typedef struct piper_synthesize_options {
   float noise_w_scale;
 } piper_synthesize_options;
 
+/**
+ * \brief Options for creating a synthesizer (ONNX Runtime threading).
+ *
+ * \sa \ref piper_default_create_options
+ */
+typedef struct piper_create_options {
+  /**
+   * \brief Threads used to run a single operator.
+   *
+   * 0 lets ONNX Runtime pick (one per physical core).
+   * Set this when other work in the process needs the remaining cores.
+   */
+  int intra_op_threads;
+
+  /**
+   * \brief Threads used to run independent operators in parallel.
+   *
+   * 0 lets ONNX Runtime pick.
+   */
+  int inter_op_threads;
+
+  /**
+   * \brief Let idle intra-op threads spin while waiting for work.
+   *
+   * Spinning lowers latency but keeps cores busy between runs.
+   * The default is true (ONNX Runtime's default).
+   */
+  bool allow_spinning;
+
+  /**
+   * \brief CPU affinities of the intra-op threads, or NULL.
+   *
+   * Uses ONNX Runtime's "session.intra_op_thread_affinities" format: one
+   * group of 1-based logical processor ids per thread except the caller's,
+   * separated by ';', e.g. "3,4;5,6" or "3-4;5-6".
+   * Requires intra_op_threads to be set.
+   */
+  const char *intra_op_thread_affinities;
+} piper_create_options;
+
+/**
+ * \brief Get the default options for creating a synthesizer.
+ *
+ * \return ONNX Runtime's default threading.
+ */
+PIPER_API piper_create_options piper_default_create_options(void);
+
 /**
  * \brief Create a Piper text-to-speech synthesizer from a voice model.
  *
@@ -169,6 +217,27 @@ typedef struct piper_synthesize_options {
 PIPER_API piper_synthesizer *piper_create(const char *model_path, const char *config_path,
                                 const char *espeak_data_path);
 
+/**
+ * \brief Create a Piper text-to-speech synthesizer with creation options.
+ *
+ * \param model_path path to ONNX voice model file.
+ *
+ * \param config_path path to JSON voice config file or NULL if it's the
+ * model_path + .json.
+ *
+ * \param espeak_data_path path to the espeak-ng data
+ * directory.
+ *
+ * \param options creation options or NULL for defaults.
+ *
+ * \sa \ref piper_default_create_options
+ *
+ * \return a Piper text-to-speech synthesizer for the voice model.
+ */
+PIPER_API piper_synthesizer *piper_create_with_options(const char *model_path, const char *config_path,
+                                             const char *espeak_data_path,
+                                             const piper_create_options *options);
+
 /**
  * \brief Free resources for Piper synthesizer.
  *
@@ -195,6 +264,9 @@ piper_default_synthesize_options(piper_synthesizer *synth);
  *
  * \param options synthesis options or NULL for defaults.
  *
+ * The text may be empty when the rest of it will be passed to
+ * piper_synthesize_append.
+ *
  * \sa \ref piper_synthesize_next
  *
  * \return PIPER_OK or error code.
@@ -215,12 +287,50 @@ PIPER_API int piper_synthesize_start(piper_synthesizer *synth, const char *text,
  * The final audio chunk will have is_last = true.
  * A return value of PIPER_DONE indicates that synthesis is complete.
  *
+ * After piper_synthesize_append, PIPER_NEED_MORE_TEXT is returned (with no
+ * audio) once all text so far has been synthesized. Append more text or
+ * call piper_synthesize_finish, then continue calling this function.
+ *
  * \sa \ref piper_synthesize_start
  *
- * \return PIPER_DONE when complete, otherwise PIPER_OK or error code.
+ * \return PIPER_DONE when complete, PIPER_NEED_MORE_TEXT when waiting for
+ * text, otherwise PIPER_OK or error code.
  */
 PIPER_API int piper_synthesize_next(piper_synthesizer *synth, piper_audio_chunk *chunk);
 
+/**
+ * \brief Add text to the current synthesis.
+ *
+ * \param synth Piper synthesizer.
+ *
+ * \param text more text to synthesize, e.g. a piece of a streamed reply.
+ *
+ * piper_synthesize_start must be called before this function.
+ * Text is phonemized and queued as soon as it contains a complete sentence
+ * (ending in '.', '?' or '!' and whitespace, or in a line break);
+ * audio already queued keeps playing through piper_synthesize_next.
+ * The stream stays open until piper_synthesize_finish is called.
+ *
+ * \sa \ref piper_synthesize_finish
+ *
+ * \return PIPER_OK or error code.
+ */
+PIPER_API int piper_synthesize_append(piper_synthesizer *synth, const char *text);
+
+/**
+ * \brief Mark the end of the text passed to piper_synthesize_append.
+ *
+ * \param synth Piper synthesizer.
+ *
+ * Any remaining partial sentence is queued, and piper_synthesize_next will
+ * return PIPER_DONE after the last of the audio.
+ *
+ * \sa \ref piper_synthesize_append
+ *
+ * \return PIPER_OK or error code.
+ */
+PIPER_API int piper_synthesize_finish(piper_synthesizer *synth);
+
 #ifdef __cplusplus
 }
 #endif
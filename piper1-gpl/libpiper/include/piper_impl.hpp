@@ -76,6 +76,11 @@ struct piper_synthesizer {
     // synthesize state
     std::queue<std::pair<std::vector<Phoneme>, std::vector<PhonemeId>>>
         phoneme_id_queue;
+
+    // piper_synthesize_append: text after the last complete sentence, and
+    // whether more text may still come
+    std::string pending_text;
+    bool text_open = false;
     std::vector<float> chunk_samples;
     std::vector<int> chunk_phoneme_ids;
     std::vector<Phoneme> chunk_phonemes;
@@ -14,9 +14,27 @@
 
 using json = nlohmann::json;
 
+piper_create_options piper_default_create_options(void) {
+    piper_create_options options;
+    options.intra_op_threads = 0;
+    options.inter_op_threads = 0;
+    options.allow_spinning = true;
+    options.intra_op_thread_affinities = nullptr;
+
+    return options;
+}
+
 struct piper_synthesizer *piper_create(const char *model_path,
                                        const char *config_path,
                                        const char *espeak_data_path) {
+    return piper_create_with_options(model_path, config_path, espeak_data_path,
+                                     nullptr);
+}
+
+struct piper_synthesizer *
+piper_create_with_options(const char *model_path, const char *config_path,
+                          const char *espeak_data_path,
+                          const piper_create_options *options) {
     if (!model_path) {
         return nullptr;
     }
@@ -101,6 +119,31 @@ struct piper_synthesizer *piper_create(const char *model_path,
     synth->session_options.DisableMemPattern();
     synth->session_options.DisableProfiling();
 
+    piper_create_options default_options = piper_default_create_options();
+    if (!options) {
+        options = &default_options;
+    }
+
+    if (options->intra_op_threads > 0) {
+        synth->session_options.SetIntraOpNumThreads(options->intra_op_threads);
+    }
+
+    if (options->inter_op_threads > 0) {
+        synth->session_options.SetInterOpNumThreads(options->inter_op_threads);
+    }
+
+    if (!options->allow_spinning) {
+        synth->session_options.AddConfigEntry(
+            "session.intra_op.allow_spinning", "0");
+    }
+
+    if (options->intra_op_thread_affinities &&
+        options->intra_op_thread_affinities[0]) {
+        synth->session_options.AddConfigEntry(
+            "session.intra_op_thread_affinities",
+            options->intra_op_thread_affinities);
+    }
+
 #ifdef _WIN32
     // Windows requires wide string for model path
     std::wstring_convert<std::codecvt_utf8_utf16<wchar_t>> converter;
@@ -142,34 +185,14 @@ piper_default_synthesize_options(piper_synthesizer *synth) {
     return options;
 }
 
-int piper_synthesize_start(struct piper_synthesizer *synth, const char *text,
-                           const piper_synthesize_options *options) {
-    if (!synth) {
-        return PIPER_ERR_GENERIC;
-    }
-
-    if (espeak_SetVoiceByName(synth->espeak_voice.c_str()) != EE_OK) {
-        return PIPER_ERR_GENERIC;
-    }
-
-    // Clear state
-    while (!synth->phoneme_id_queue.empty()) {
-        synth->phoneme_id_queue.pop();
-    }
-    synth->chunk_samples.clear();
-
-    std::unique_ptr<piper_synthesize_options> default_options;
-    if (!options) {
-        default_options = std::make_unique<piper_synthesize_options>(
-            piper_default_synthesize_options(synth));
-        options = default_options.get();
+// Phonemize text and queue the phoneme ids of each sentence
+static void queue_text(struct piper_synthesizer *synth, const char *text) {
+    // Nothing to say (e.g. piper_synthesize_start before appending)
+    if (!text || std::string(text).find_first_not_of(" \t\r\n") ==
+                     std::string::npos) {
+        return;
     }
 
-    synth->length_scale = options->length_scale;
-    synth->noise_scale = options->noise_scale;
-    synth->noise_w_scale = options->noise_w_scale;
-    synth->speaker_id = options->speaker_id;
-
     // phonemize
     std::vector<std::string> sentence_phonemes{""};
     std::size_t current_idx = 0;
@@ -272,6 +295,99 @@ int piper_synthesize_start(struct piper_synthesizer *synth, const char *text,
             std::move(std::make_pair(sentence_codepoints, sentence_ids)));
         sentence_ids.clear();
     }
+}
+
+int piper_synthesize_start(struct piper_synthesizer *synth, const char *text,
+                           const piper_synthesize_options *options) {
+    if (!synth) {
+        return PIPER_ERR_GENERIC;
+    }
+
+    if (espeak_SetVoiceByName(synth->espeak_voice.c_str()) != EE_OK) {
+        return PIPER_ERR_GENERIC;
+    }
+
+    // Clear state
+    while (!synth->phoneme_id_queue.empty()) {
+        synth->phoneme_id_queue.pop();
+    }
+    synth->chunk_samples.clear();
+
+    std::unique_ptr<piper_synthesize_options> default_options;
+    if (!options) {
+        default_options = std::make_unique<piper_synthesize_options>(
+            piper_default_synthesize_options(synth));
+        options = default_options.get();
+    }
+
+    synth->length_scale = options->length_scale;
+    synth->noise_scale = options->noise_scale;
+    synth->noise_w_scale = options->noise_w_scale;
+    synth->speaker_id = options->speaker_id;
+
+    synth->pending_text.clear();
+    synth->text_open = false;
+
+    queue_text(synth, text);
+
+    return PIPER_OK;
+}
+
+int piper_synthesize_append(struct piper_synthesizer *synth,
+                            const char *text) {
+    if (!synth || !text) {
+        return PIPER_ERR_GENERIC;
+    }
+
+    if (espeak_SetVoiceByName(synth->espeak_voice.c_str()) != EE_OK) {
+        return PIPER_ERR_GENERIC;
+    }
+
+    synth->pending_text += text;
+    synth->text_open = true;
+
+    // Only whole sentences are phonemized: espeak needs the end of a
+    // sentence to get words and intonation right. A line break always ends
+    // one, so callers that split sentences themselves can append "...\n".
+    std::size_t end = std::string::npos;
+    for (std::size_t i = 0; i < synth->pending_text.size(); i++) {
+        char c = synth->pending_text[i];
+        if (c == '\n') {
+            end = i + 1;
+            continue;
+        }
+
+        if ((c == '.' || c == '?' || c == '!') &&
+            (i + 1 < synth->pending_text.size())) {
+            char next = synth->pending_text[i + 1];
+            if (next == ' ' || next == '\r' || next == '\t') {
+                end = i + 1;
+            }
+        }
+    }
+
+    if (end != std::string::npos) {
+        std::string sentences = synth->pending_text.substr(0, end);
+        synth->pending_text.erase(0, end);
+        queue_text(synth, sentences.c_str());
+    }
+
+    return PIPER_OK;
+}
+
+int piper_synthesize_finish(struct piper_synthesizer *synth) {
+    if (!synth) {
+        return PIPER_ERR_GENERIC;
+    }
+
+    if (!synth->pending_text.empty()) {
+        if (espeak_SetVoiceByName(synth->espeak_voice.c_str()) != EE_OK) {
+            return PIPER_ERR_GENERIC;
+        }
+        queue_text(synth, synth->pending_text.c_str());
+        synth->pending_text.clear();
+    }
+    synth->text_open = false;
 
     return PIPER_OK;
 }
@@ -302,6 +418,11 @@ int piper_synthesize_next(struct piper_synthesizer *synth,
     chunk->num_alignments = 0;
 
     if (synth->phoneme_id_queue.empty()) {
+        if (synth->text_open) {
+            // Waiting for piper_synthesize_append/finish
+            return PIPER_NEED_MORE_TEXT;
+        }
+
         // Empty final chunk
         chunk->is_last = true;
         return PIPER_DONE;
@@ -380,7 +501,7 @@ int piper_synthesize_next(struct piper_synthesizer *synth,
               synth->chunk_samples.begin());
     chunk->samples = synth->chunk_samples.data();
 
-    chunk->is_last = synth->phoneme_id_queue.empty();
+    chunk->is_last = synth->phoneme_id_queue.empty() && !synth->text_open;
 
     // Copy phonemes
     synth->chunk_phonemes = std::move(next_phonemes);
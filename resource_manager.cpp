@@ -0,0 +1,209 @@
+#include "resource_manager.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include <sstream>
+#include <thread>
+
+#ifdef _WIN32
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+bool parse_core_list(const std::string& list, std::vector<int>& cores) {
+    cores.clear();
+
+    std::stringstream ss(list);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        if (item.empty()) {
+            continue;
+        }
+
+        int first = 0;
+        int last = 0;
+        char extra = 0;
+        if (sscanf(item.c_str(), "%d-%d%c", &first, &last, &extra) == 2) {
+            // range
+        } else if (sscanf(item.c_str(), "%d%c", &first, &extra) == 1) {
+            last = first;
+        } else {
+            return false;
+        }
+
+        if (first < 0 || last < first) {
+            return false;
+        }
+        for (int core = first; core <= last; core++) {
+            cores.push_back(core);
+        }
+    }
+
+    std::sort(cores.begin(), cores.end());
+    cores.erase(std::unique(cores.begin(), cores.end()), cores.end());
+
+    return !cores.empty();
+}
+
+std::vector<int> available_cores() {
+    std::vector<int> cores;
+
+#ifdef _WIN32
+    DWORD_PTR process_mask = 0;
+    DWORD_PTR system_mask = 0;
+    if (GetProcessAffinityMask(GetCurrentProcess(), &process_mask, &system_mask)) {
+        for (int i = 0; i < (int)(8 * sizeof(DWORD_PTR)); i++) {
+            if (process_mask & ((DWORD_PTR)1 << i)) {
+                cores.push_back(i);
+            }
+        }
+    }
+#elif defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+        for (int i = 0; i < CPU_SETSIZE; i++) {
+            if (CPU_ISSET(i, &set)) {
+                cores.push_back(i);
+            }
+        }
+    }
+#endif
+
+    if (cores.empty()) {
+        const int n = std::max(1, (int)std::thread::hardware_concurrency());
+        for (int i = 0; i < n; i++) {
+            cores.push_back(i);
+        }
+    }
+
+    return cores;
+}
+
+bool set_thread_affinity(const std::vector<int>& cores) {
+    if (cores.empty()) {
+        return false;
+    }
+
+#ifdef _WIN32
+    DWORD_PTR mask = 0;
+    for (int core : cores) {
+        if (core < (int)(8 * sizeof(DWORD_PTR))) {
+            mask |= (DWORD_PTR)1 << core;
+        }
+    }
+    return mask != 0 && SetThreadAffinityMask(GetCurrentThread(), mask) != 0;
+#elif defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int core : cores) {
+        if (core < CPU_SETSIZE) {
+            CPU_SET(core, &set);
+        }
+    }
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+    return false;
+#endif
+}
+
+bool ResourceManager::init(const std::string& stt_cores, const std::string& tts_cores, bool pin) {
+    m_pin = pin;
+
+    const std::vector<int> all = available_cores();
+
+    if (!stt_cores.empty() && !parse_core_list(stt_cores, m_stt.cores)) {
+        fprintf(stderr, "%s: invalid STT core list '%s'\n", __func__, stt_cores.c_str());
+        return false;
+    }
+    if (!tts_cores.empty() && !parse_core_list(tts_cores, m_tts.cores)) {
+        fprintf(stderr, "%s: invalid TTS core list '%s'\n", __func__, tts_cores.c_str());
+        return false;
+    }
+
+    // Cores of all not claimed by the given list
+    auto rest = [&all](const std::vector<int>& taken) {
+        std::vector<int> cores;
+        for (int core : all) {
+            if (std::find(taken.begin(), taken.end(), core) == taken.end()) {
+                cores.push_back(core);
+            }
+        }
+        return cores.empty() ? all : cores;
+    };
+
+    if (m_stt.cores.empty() && m_tts.cores.empty()) {
+        // Synthesizing a sentence is much lighter than transcribing one
+        const size_t n_tts = all.size() > 1 ? std::max<size_t>(1, all.size() / 4) : all.size();
+        m_tts.cores.assign(all.end() - n_tts, all.end());
+        m_stt.cores = rest(m_tts.cores);
+    } else if (m_stt.cores.empty()) {
+        m_stt.cores = rest(m_tts.cores);
+    } else if (m_tts.cores.empty()) {
+        m_tts.cores = rest(m_stt.cores);
+    }
+
+    m_stt.n_threads = (int)m_stt.cores.size();
+    m_tts.n_threads = (int)m_tts.cores.size();
+
+    return true;
+}
+
+int ResourceManager::stt_threads_per_worker(int n_threads, int n_workers) const {
+    const int budget = std::max(1, m_stt.n_threads / std::max(1, n_workers));
+    return std::max(1, std::min(n_threads, budget));
+}
+
+std::string ResourceManager::tts_thread_affinities() const {
+    if (!m_pin) {
+        return "";
+    }
+
+    // One core per ORT thread; the first (the caller's) is pinned by us.
+    // ORT counts logical processors from 1.
+    std::string affinities;
+    for (size_t i = 1; i < m_tts.cores.size(); i++) {
+        if (!affinities.empty()) {
+            affinities += ';';
+        }
+        affinities += std::to_string(m_tts.cores[i] + 1);
+    }
+    return affinities;
+}
+
+bool ResourceManager::pin_current_thread(Stage stage) const {
+    if (!m_pin) {
+        return true;
+    }
+
+    const StageResources& res = this->stage(stage);
+    if (!set_thread_affinity(res.cores)) {
+        fprintf(stderr, "%s: failed to set thread affinity\n", __func__);
+        return false;
+    }
+    return true;
+}
+
+std::string ResourceManager::describe() const {
+    auto list = [](const std::vector<int>& cores) {
+        std::string s;
+        for (size_t i = 0; i < cores.size(); i++) {
+            s += (i > 0 ? "," : "") + std::to_string(cores[i]);
+        }
+        return s;
+    };
+
+    std::string s;
+    s += "STT cores " + list(m_stt.cores) + " (" + std::to_string(m_stt.n_threads) + " threads)\n";
+    s += "TTS cores " + list(m_tts.cores) + " (" + std::to_string(m_tts.n_threads) + " threads)\n";
+    s += m_pin ? "Threads pinned to their cores\n" : "Thread counts capped, no affinity\n";
+
+    if (!std::getenv("OMP_WAIT_POLICY")) {
+        s += "Set OMP_WAIT_POLICY=PASSIVE so idle whisper threads do not spin\n";
+    }
+
+    return s;
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// CPU partitioning between the pipeline stages.
+//
+// whisper (ggml-cpu with OpenMP) and piper (ONNX Runtime) each bring their
+// own thread pool and size it for the whole machine, so speech of one reply
+// and transcription of the next utterance fight over the same cores. The
+// resource manager gives each stage a core set and a thread budget:
+//
+//   - STT: whisper threads per worker x STT workers <= STT cores. The STT
+//     worker threads are pinned to the STT cores; the OpenMP threads they
+//     start inherit that affinity.
+//   - TTS: ONNX Runtime intra-op threads = TTS cores, pinned the same way
+//     (the synthesizing thread plus ORT's own threads).
+//
+// libgomp reads its settings when it is loaded, so OMP_WAIT_POLICY=PASSIVE
+// (idle OpenMP threads sleep instead of spinning) has to come from the
+// environment; describe() mentions it when unset.
+
+enum class Stage {
+    Stt,
+    Tts,
+};
+
+// Cores and threads for one stage
+struct StageResources {
+    std::vector<int> cores;  // logical CPU ids
+    int n_threads = 0;
+};
+
+class ResourceManager {
+public:
+    // Split the cores this process may run on. stt_cores / tts_cores are
+    // lists such as "0-3,6"; an empty list gets the cores the other stage
+    // does not use (both empty: about a quarter for TTS, the rest for STT).
+    // pin sets thread affinities; without it only thread counts are capped.
+    bool init(const std::string& stt_cores, const std::string& tts_cores, bool pin);
+
+    const StageResources& stage(Stage stage) const { return stage == Stage::Stt ? m_stt : m_tts; }
+
+    // Largest whisper thread count per worker that fits the STT budget
+    int stt_threads_per_worker(int n_threads, int n_workers) const;
+
+    // ONNX Runtime "session.intra_op_thread_affinities" for the TTS cores
+    // (empty without pinning)
+    std::string tts_thread_affinities() const;
+
+    // Pin the calling thread to the stage's cores (no-op without pinning)
+    bool pin_current_thread(Stage stage) const;
+
+    bool pinning() const { return m_pin; }
+
+    // One line per stage, for the startup log
+    std::string describe() const;
+
+private:
+    bool m_pin = false;
+
+    StageResources m_stt;
+    StageResources m_tts;
+};
+
+// Parse a core list such as "0-3,6". Returns false on syntax errors.
+bool parse_core_list(const std::string& list, std::vector<int>& cores);
+
+// Logical CPUs the process may run on
+std::vector<int> available_cores();
+
+// Restrict the calling thread to cores
+bool set_thread_affinity(const std::vector<int>& cores);
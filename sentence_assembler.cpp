@@ -0,0 +1,131 @@
+#include "sentence_assembler.h"
+
+#include <cctype>
+#include <cstring>
+
+// Words ending in '.' that rarely end a sentence (lowercase, without the dot)
+static const char* ABBREVIATIONS[] = {
+    "mr", "mrs", "ms", "dr", "st", "sr", "jr", "mt", "vs", "etc", "e.g", "i.e",
+};
+
+static bool isSpace(char c) {
+    return std::isspace((unsigned char)c) != 0;
+}
+
+SentenceAssembler::SentenceAssembler(SentenceCallback onSentence, size_t maxChars)
+    : m_onSentence(std::move(onSentence)), m_maxChars(maxChars) {
+}
+
+void SentenceAssembler::reset() {
+    m_buffer.clear();
+}
+
+void SentenceAssembler::push(const std::string& text) {
+    m_buffer += text;
+
+    while (true) {
+        size_t end = findBoundary();
+
+        if (end == 0 && m_buffer.size() > m_maxChars) {
+            // Run-on clause: break after the last pause before the limit
+            const size_t pause = m_buffer.find_last_of(",;:", m_maxChars);
+            if (pause != std::string::npos && pause + 1 < m_buffer.size() && isSpace(m_buffer[pause + 1])) {
+                end = pause + 1;
+            }
+        }
+
+        if (end == 0) {
+            break;
+        }
+        emit(end);
+    }
+}
+
+void SentenceAssembler::flush() {
+    emit(m_buffer.size());
+}
+
+size_t SentenceAssembler::findBoundary() const {
+    for (size_t i = 0; i < m_buffer.size(); i++) {
+        const char c = m_buffer[i];
+
+        if (c == '\n') {
+            return i + 1;
+        }
+
+        if (c != '.' && c != '!' && c != '?') {
+            continue;
+        }
+
+        // Include repeated punctuation and closing quotes / brackets
+        size_t end = i + 1;
+        while (end < m_buffer.size() && strchr(".!?\"')]", m_buffer[end])) {
+            end++;
+        }
+
+        // Whether this ends the sentence is only known once the next
+        // character has arrived
+        if (end >= m_buffer.size()) {
+            return 0;
+        }
+        if (!isSpace(m_buffer[end])) {
+            i = end - 1;
+            continue;  // "3.5", "...and", "?!" inside a word
+        }
+        if (c == '.' && end == i + 1 && isAbbreviation(i)) {
+            continue;
+        }
+
+        return end;
+    }
+
+    return 0;
+}
+
+bool SentenceAssembler::isAbbreviation(size_t dot) const {
+    size_t start = dot;
+    while (start > 0 && !isSpace(m_buffer[start - 1])) {
+        start--;
+    }
+
+    std::string word;
+    for (size_t i = start; i < dot; i++) {
+        word += (char)std::tolower((unsigned char)m_buffer[i]);
+    }
+
+    // Single letters are initials ("J. R. R.")
+    if (word.size() == 1 && std::isalpha((unsigned char)word[0])) {
+        return true;
+    }
+
+    for (const char* abbreviation : ABBREVIATIONS) {
+        if (word == abbreviation) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void SentenceAssembler::emit(size_t end) {
+    std::string sentence = m_buffer.substr(0, end);
+
+    // Leading whitespace stays out of both the sentence and the buffer
+    size_t next = end;
+    while (next < m_buffer.size() && isSpace(m_buffer[next])) {
+        next++;
+    }
+    m_buffer.erase(0, next);
+
+    size_t first = 0;
+    while (first < sentence.size() && isSpace(sentence[first])) {
+        first++;
+    }
+    size_t last = sentence.size();
+    while (last > first && isSpace(sentence[last - 1])) {
+        last--;
+    }
+
+    if (last > first) {
+        m_onSentence(sentence.substr(first, last - first));
+    }
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <functional>
+#include <string>
+
+// Collects streamed LLM tokens and hands out whole sentences, so speech
+// synthesis can start on the first sentence while the model is still
+// writing the next one.
+//
+// A sentence ends at '.', '!' or '?' (plus closing quotes / brackets)
+// followed by whitespace, or at a line break. Decimal numbers and common
+// abbreviations ("Mr.", "e.g.") do not end a sentence. Clauses that run on
+// past maxChars are split at the last comma, semicolon or colon so a long
+// sentence does not hold back the audio.
+class SentenceAssembler {
+public:
+    using SentenceCallback = std::function<void(const std::string& sentence)>;
+
+    explicit SentenceAssembler(SentenceCallback onSentence, size_t maxChars = 160);
+
+    // Add streamed text; complete sentences go to the callback
+    void push(const std::string& text);
+
+    // End of the reply: emit whatever is left
+    void flush();
+
+    // Drop buffered text without emitting it
+    void reset();
+
+private:
+    // Index just past the first sentence end in m_buffer, or 0
+    size_t findBoundary() const;
+    bool isAbbreviation(size_t dot) const;
+
+    void emit(size_t end);
+
+    SentenceCallback m_onSentence;
+    size_t m_maxChars;
+    std::string m_buffer;
+};
@@ -0,0 +1,72 @@
+#include "sse_parser.h"
+
+SseParser::SseParser(EventCallback onEvent) : m_onEvent(std::move(onEvent)) {
+}
+
+void SseParser::reset() {
+    m_line.clear();
+    m_data.clear();
+    m_hasData = false;
+    m_skipLf = false;
+    m_stopped = false;
+}
+
+bool SseParser::feed(const char* data, size_t size) {
+    for (size_t i = 0; i < size && !m_stopped; i++) {
+        const char c = data[i];
+
+        // Lines end in "\r\n", "\n" or "\r"
+        if (c == '\n' && m_skipLf) {
+            m_skipLf = false;
+            continue;
+        }
+        m_skipLf = false;
+
+        if (c == '\r' || c == '\n') {
+            m_skipLf = c == '\r';
+            m_stopped = !processLine();
+            m_line.clear();
+        } else {
+            m_line += c;
+        }
+    }
+
+    return !m_stopped;
+}
+
+bool SseParser::processLine() {
+    // A blank line dispatches the event
+    if (m_line.empty()) {
+        if (!m_hasData) {
+            return true;
+        }
+        const bool more = m_onEvent(m_data);
+        m_data.clear();
+        m_hasData = false;
+        return more;
+    }
+
+    if (m_line[0] == ':') {
+        return true;  // comment, e.g. keep-alive
+    }
+
+    const size_t colon = m_line.find(':');
+    const std::string field = m_line.substr(0, colon);
+    if (field != "data") {
+        return true;  // event, id, retry: not needed here
+    }
+
+    // The value starts after the colon and one optional space
+    size_t start = colon == std::string::npos ? m_line.size() : colon + 1;
+    if (start < m_line.size() && m_line[start] == ' ') {
+        start++;
+    }
+
+    if (m_hasData) {
+        m_data += '\n';
+    }
+    m_data.append(m_line, start, std::string::npos);
+    m_hasData = true;
+
+    return true;
+}
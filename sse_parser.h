@@ -0,0 +1,35 @@
+#pragma once
+
+#include <functional>
+#include <string>
+
+// Incremental parser for server-sent events (text/event-stream).
+//
+// Bytes are fed as they arrive from the network, split anywhere; each
+// complete event's data (its "data:" lines joined with '\n') is passed to
+// the callback once the blank line that ends it is seen. Comments (lines
+// starting with ':') and other fields are skipped.
+class SseParser {
+public:
+    // Return false to stop parsing
+    using EventCallback = std::function<bool(const std::string& data)>;
+
+    explicit SseParser(EventCallback onEvent);
+
+    // Parse more of the stream. Returns false once the callback asked to
+    // stop.
+    bool feed(const char* data, size_t size);
+
+    // Start over for a new stream
+    void reset();
+
+private:
+    bool processLine();
+
+    EventCallback m_onEvent;
+    std::string m_line;
+    std::string m_data;
+    bool m_hasData = false;
+    bool m_skipLf = false;  // the last line ended in '\r'; a '\n' may follow
+    bool m_stopped = false;
+};
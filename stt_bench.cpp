@@ -0,0 +1,374 @@
+// STT benchmark: runs a directory of WAV files (with optional reference
+// transcripts in same-named .txt files) through the whisper setup used by
+// voice_chat and reports latency, encoder/decoder split, real-time factor
+// and word error rate.
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <memory>
+#include <algorithm>
+
+#include "whisper.h"
+#include "ggml-backend.h"
+#include "endpointer.h"
+#include "stt_metrics.h"
+#include "stt_params.h"
+#include "stt_stream.h"
+#include "stt_worker.h"
+#include "wav_file.h"
+
+struct stt_bench_params {
+    std::string whisper_model = "";
+    std::string corpus_dir = "";
+    int n_threads = 4;       // per whisper run
+    int n_jobs = 1;          // concurrent whisper runs
+    bool trim = false;       // cut to the detected speech like voice_chat does
+    int vad_margin_ms = 200;
+    int vad_hangover_ms = 400;
+    bool fit_audio_ctx = true;
+    bool verbose = false;
+};
+
+void print_usage(const char* prog) {
+    fprintf(stderr, "Usage: %s -wm <whisper_model> -d <corpus_dir> [options]\n", prog);
+    fprintf(stderr, "\n");
+    fprintf(stderr, "Every <name>.wav in the corpus is transcribed; <name>.txt, if present,\n");
+    fprintf(stderr, "holds the reference transcript used for WER.\n");
+    fprintf(stderr, "\n");
+    fprintf(stderr, "Options:\n");
+    fprintf(stderr, "  -wm, --whisper-model <path>  Path to whisper model (.bin)\n");
+    fprintf(stderr, "  -d,  --dir <path>            Corpus directory\n");
+    fprintf(stderr, "  -t,  --threads <n>           Threads per whisper run (default: 4)\n");
+    fprintf(stderr, "  -j,  --jobs <n>              Concurrent whisper runs sharing the model (default: 1)\n");
+    fprintf(stderr, "       --trim                  Transcribe only the detected speech, as voice_chat does\n");
+    fprintf(stderr, "  -vm, --vad-margin <ms>       Audio kept around detected speech (default: 200)\n");
+    fprintf(stderr, "  -vh, --vad-hangover <ms>     Silence before end of utterance (default: 400)\n");
+    fprintf(stderr, "  -nac, --no-audio-ctx         Always run the encoder over the full 30 s context\n");
+    fprintf(stderr, "  -v,  --verbose               Print transcripts\n");
+    fprintf(stderr, "  -h,  --help                  Show this help\n");
+}
+
+bool parse_args(int argc, char** argv, stt_bench_params& params) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+
+        if (arg == "-h" || arg == "--help") {
+            print_usage(argv[0]);
+            exit(0);
+        }
+        else if ((arg == "-wm" || arg == "--whisper-model") && i + 1 < argc) {
+            params.whisper_model = argv[++i];
+        }
+        else if ((arg == "-d" || arg == "--dir") && i + 1 < argc) {
+            params.corpus_dir = argv[++i];
+        }
+        else if ((arg == "-t" || arg == "--threads") && i + 1 < argc) {
+            params.n_threads = std::stoi(argv[++i]);
+        }
+        else if ((arg == "-j" || arg == "--jobs") && i + 1 < argc) {
+            params.n_jobs = std::stoi(argv[++i]);
+        }
+        else if (arg == "--trim") {
+            params.trim = true;
+        }
+        else if ((arg == "-vm" || arg == "--vad-margin") && i + 1 < argc) {
+            params.vad_margin_ms = std::stoi(argv[++i]);
+        }
+        else if ((arg == "-vh" || arg == "--vad-hangover") && i + 1 < argc) {
+            params.vad_hangover_ms = std::stoi(argv[++i]);
+        }
+        else if (arg == "-nac" || arg == "--no-audio-ctx") {
+            params.fit_audio_ctx = false;
+        }
+        else if (arg == "-v" || arg == "--verbose") {
+            params.verbose = true;
+        }
+        else {
+            fprintf(stderr, "Unknown argument: %s\n", arg.c_str());
+            print_usage(argv[0]);
+            return false;
+        }
+    }
+
+    if (params.whisper_model.empty()) {
+        fprintf(stderr, "Error: Whisper model path required (-wm)\n");
+        return false;
+    }
+    if (params.corpus_dir.empty()) {
+        fprintf(stderr, "Error: Corpus directory required (-d)\n");
+        return false;
+    }
+
+    return true;
+}
+
+using Clock = std::chrono::steady_clock;
+
+struct Utterance {
+    std::string name;
+    std::string reference;
+    bool has_reference = false;
+    double audio_ms = 0.0;   // whole file
+    std::vector<float> pcm;  // what goes to whisper
+
+    // Filled in on the worker thread
+    Clock::time_point t_start;
+    Clock::time_point t_encode;  // encoder starts (log-mel done)
+    Clock::time_point t_decode;  // first decoder step done
+    Clock::time_point t_end;
+    bool encode_seen = false;
+    bool decode_seen = false;
+};
+
+static double ms_between(Clock::time_point a, Clock::time_point b) {
+    return std::chrono::duration<double, std::milli>(b - a).count();
+}
+
+static bool on_encoder_begin(whisper_context*, whisper_state*, void* user_data) {
+    Utterance* u = (Utterance*)user_data;
+    if (!u->encode_seen) {
+        u->encode_seen = true;
+        u->t_encode = Clock::now();
+    }
+    return true;
+}
+
+static void on_logits(whisper_context*, whisper_state*, const whisper_token_data*, int, float*, void* user_data) {
+    Utterance* u = (Utterance*)user_data;
+    if (!u->decode_seen) {
+        u->decode_seen = true;
+        u->t_decode = Clock::now();
+    }
+}
+
+// Cut to [first speech start - margin, last speech end + margin], the way
+// voice_chat hands a single utterance to whisper
+static void trim_to_speech(std::vector<float>& pcm, const stt_bench_params& params) {
+    EndpointerParams ep_params;
+    ep_params.hangover_ms = params.vad_hangover_ms;
+    Endpointer endpointer(WHISPER_SAMPLE_RATE, ep_params);
+
+    bool found = false;
+    uint64_t start = 0;
+    uint64_t end = pcm.size();
+
+    // Feed in capture-sized blocks so events land where they would live
+    const size_t block = WHISPER_SAMPLE_RATE / 100;
+    for (size_t pos = 0; pos < pcm.size(); pos += block) {
+        const size_t n = std::min(block, pcm.size() - pos);
+        const EndpointEvent event = endpointer.process(pos, pcm.data() + pos, n);
+
+        if (event == EndpointEvent::SpeechStart && !found) {
+            found = true;
+            start = endpointer.speech_start();
+        }
+        if (event == EndpointEvent::SpeechEnd) {
+            end = endpointer.speech_end();
+        }
+    }
+    if (endpointer.in_speech()) {
+        end = pcm.size();
+    }
+    if (!found) {
+        return;
+    }
+
+    const uint64_t margin = (uint64_t)params.vad_margin_ms * WHISPER_SAMPLE_RATE / 1000;
+    const uint64_t begin = start > margin ? start - margin : 0;
+    end = std::min<uint64_t>(end + margin, pcm.size());
+
+    pcm = std::vector<float>(pcm.begin() + begin, pcm.begin() + end);
+}
+
+static bool load_corpus(const stt_bench_params& params, std::vector<std::unique_ptr<Utterance>>& corpus) {
+    namespace fs = std::filesystem;
+
+    std::vector<fs::path> files;
+    std::error_code ec;
+    for (const auto& entry : fs::directory_iterator(params.corpus_dir, ec)) {
+        if (entry.is_regular_file() && entry.path().extension() == ".wav") {
+            files.push_back(entry.path());
+        }
+    }
+    if (ec) {
+        fprintf(stderr, "Error: cannot list %s: %s\n", params.corpus_dir.c_str(), ec.message().c_str());
+        return false;
+    }
+    std::sort(files.begin(), files.end());
+
+    for (const auto& path : files) {
+        std::vector<float> samples;
+        int sample_rate = 0;
+        if (!read_wav(path.string(), samples, sample_rate)) {
+            continue;
+        }
+
+        std::unique_ptr<Utterance> u(new Utterance());
+        u->name = path.filename().string();
+
+        if (sample_rate != WHISPER_SAMPLE_RATE) {
+            resample_linear(samples, sample_rate, u->pcm, WHISPER_SAMPLE_RATE);
+        } else {
+            u->pcm = std::move(samples);
+        }
+        u->audio_ms = 1000.0 * u->pcm.size() / WHISPER_SAMPLE_RATE;
+
+        if (params.trim) {
+            trim_to_speech(u->pcm, params);
+        }
+        if (u->pcm.size() < STT_MIN_SAMPLES) {
+            u->pcm.resize(STT_MIN_SAMPLES, 0.0f);
+        }
+
+        fs::path ref_path = path;
+        ref_path.replace_extension(".txt");
+        std::ifstream ref(ref_path);
+        if (ref) {
+            std::stringstream ss;
+            ss << ref.rdbuf();
+            u->reference = ss.str();
+            u->has_reference = true;
+        }
+
+        corpus.push_back(std::move(u));
+    }
+
+    return !corpus.empty();
+}
+
+static double percentile(std::vector<double> values, double p) {
+    if (values.empty()) {
+        return 0.0;
+    }
+    std::sort(values.begin(), values.end());
+    const size_t i = std::min(values.size() - 1, (size_t)(p * (values.size() - 1) + 0.5));
+    return values[i];
+}
+
+int main(int argc, char** argv) {
+    stt_bench_params params;
+
+    if (!parse_args(argc, argv, params)) {
+        return 1;
+    }
+
+    std::vector<std::unique_ptr<Utterance>> corpus;
+    if (!load_corpus(params, corpus)) {
+        fprintf(stderr, "Error: No readable WAV files in %s\n", params.corpus_dir.c_str());
+        return 1;
+    }
+    fprintf(stderr, "Loaded %zu utterances from %s\n", corpus.size(), params.corpus_dir.c_str());
+
+    ggml_backend_load_all();
+
+    SttWorker stt(corpus.size());
+    if (!stt.init(params.whisper_model, make_whisper_context_params(), params.n_jobs)) {
+        fprintf(stderr, "Error: Failed to load whisper model\n");
+        return 1;
+    }
+
+    const whisper_full_params wparams = make_whisper_params(params.n_threads);
+
+    // Submit everything at once; each utterance is its own session so the
+    // jobs spread over the workers
+    std::vector<std::future<SttResult>> results(corpus.size());
+    const auto t_wall = Clock::now();
+
+    for (size_t i = 0; i < corpus.size(); i++) {
+        Utterance* u = corpus[i].get();
+
+        whisper_full_params uparams = wparams;
+        if (params.fit_audio_ctx) {
+            uparams.audio_ctx = whisper_audio_ctx_for(u->pcm.size());
+        }
+        uparams.encoder_begin_callback = on_encoder_begin;
+        uparams.encoder_begin_callback_user_data = u;
+        uparams.logits_filter_callback = on_logits;
+        uparams.logits_filter_callback_user_data = u;
+
+        stt.submit((int)i, [u, uparams](whisper_context* ctx, whisper_state* state) {
+            SttResult result;
+            u->t_start = Clock::now();
+            result.ok = whisper_full_with_state(ctx, state, uparams, u->pcm.data(), (int)u->pcm.size()) == 0;
+            u->t_end = Clock::now();
+            if (result.ok) {
+                result.text = whisper_state_text(state);
+            }
+            return result;
+        }, results[i]);
+    }
+
+    printf("%-32s %8s %8s %8s %8s %8s %6s %7s\n", "file", "audio_s", "lat_ms", "mel_ms", "enc_ms", "dec_ms", "RTF", "WER");
+
+    std::vector<double> latencies;
+    double sum_latency_ms = 0.0;
+    double sum_rtf = 0.0;
+    double sum_audio_ms = 0.0;
+    int total_errors = 0;
+    int total_ref_words = 0;
+    int n_failed = 0;
+
+    for (size_t i = 0; i < corpus.size(); i++) {
+        const Utterance& u = *corpus[i];
+        const SttResult result = results[i].valid() ? results[i].get() : SttResult();
+
+        if (!result.ok) {
+            fprintf(stderr, "%s: whisper failed\n", u.name.c_str());
+            n_failed++;
+            continue;
+        }
+
+        const double latency_ms = ms_between(u.t_start, u.t_end);
+        const double mel_ms = u.encode_seen ? ms_between(u.t_start, u.t_encode) : 0.0;
+        const double enc_ms = u.encode_seen && u.decode_seen ? ms_between(u.t_encode, u.t_decode) : 0.0;
+        const double dec_ms = u.decode_seen ? ms_between(u.t_decode, u.t_end) : 0.0;
+        const double rtf = real_time_factor(latency_ms, u.audio_ms);
+
+        latencies.push_back(latency_ms);
+        sum_latency_ms += latency_ms;
+        sum_rtf += rtf;
+        sum_audio_ms += u.audio_ms;
+
+        char wer_str[16] = "-";
+        if (u.has_reference) {
+            const std::vector<std::string> ref_words = normalize_words(u.reference);
+            const int errors = word_edit_distance(ref_words, normalize_words(result.text));
+            total_errors += errors;
+            total_ref_words += (int)ref_words.size();
+            snprintf(wer_str, sizeof(wer_str), "%.1f%%", ref_words.empty() ? 0.0 : 100.0 * errors / ref_words.size());
+        }
+
+        printf("%-32s %8.2f %8.0f %8.0f %8.0f %8.0f %6.3f %7s\n",
+               u.name.c_str(), u.audio_ms / 1000.0, latency_ms, mel_ms, enc_ms, dec_ms, rtf, wer_str);
+        if (params.verbose) {
+            printf("    %s\n", result.text.c_str());
+        }
+    }
+
+    const double wall_ms = ms_between(t_wall, Clock::now());
+
+    stt.stop();
+
+    if (latencies.empty()) {
+        fprintf(stderr, "Error: every utterance failed\n");
+        return 1;
+    }
+
+    printf("\n");
+    printf("utterances:  %zu (%d failed), %d jobs x %d threads\n", latencies.size(), n_failed, params.n_jobs, params.n_threads);
+    printf("latency:     mean %.0f ms, p50 %.0f ms, p95 %.0f ms\n",
+           sum_latency_ms / latencies.size(), percentile(latencies, 0.5), percentile(latencies, 0.95));
+    printf("RTF:         mean %.3f, throughput %.1fx real time\n",
+           sum_rtf / latencies.size(), wall_ms > 0.0 ? sum_audio_ms / wall_ms : 0.0);
+    if (total_ref_words > 0) {
+        printf("WER:         %.2f%% (%d errors / %d words)\n", 100.0 * total_errors / total_ref_words, total_errors, total_ref_words);
+    }
+
+    return n_failed > 0 ? 1 : 0;
+}
@@ -0,0 +1,234 @@
+#include "stt_calibrate.h"
+#include "stt_metrics.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+#ifdef __APPLE__
+#include <sys/sysctl.h>
+#endif
+
+std::string cpu_signature() {
+    std::string name;
+
+#if defined(_WIN32)
+    if (const char* id = std::getenv("PROCESSOR_IDENTIFIER")) {
+        name = id;
+    }
+#elif defined(__APPLE__)
+    char brand[256] = {0};
+    size_t size = sizeof(brand);
+    if (sysctlbyname("machdep.cpu.brand_string", brand, &size, nullptr, 0) == 0) {
+        name = brand;
+    }
+#else
+    std::ifstream cpuinfo("/proc/cpuinfo");
+    std::string line;
+    while (std::getline(cpuinfo, line)) {
+        // "model name" on x86, "Model" on some ARM boards
+        if (line.compare(0, 10, "model name") == 0 || line.compare(0, 5, "Model") == 0) {
+            const size_t colon = line.find(':');
+            if (colon != std::string::npos) {
+                name = line.substr(colon + 1);
+                break;
+            }
+        }
+    }
+#endif
+
+    // Trim, and keep tabs out of the calibration file format
+    std::replace(name.begin(), name.end(), '\t', ' ');
+    const size_t start = name.find_first_not_of(' ');
+    const size_t end = name.find_last_not_of(' ');
+    name = start == std::string::npos ? "unknown" : name.substr(start, end - start + 1);
+
+    return name + " x" + std::to_string(std::thread::hardware_concurrency());
+}
+
+bool load_stt_calibration(const std::string& path, const std::string& cpu, SttCalibration& cal) {
+    std::ifstream file(path);
+    if (!file) {
+        return false;
+    }
+
+    // cpu <TAB> model <TAB> threads <TAB> rtf <TAB> wer
+    std::string line;
+    while (std::getline(file, line)) {
+        std::istringstream fields(line);
+        std::string sig, model, threads, rtf, wer;
+        if (!std::getline(fields, sig, '\t') || sig != cpu) {
+            continue;
+        }
+        if (!std::getline(fields, model, '\t') || !std::getline(fields, threads, '\t') ||
+            !std::getline(fields, rtf, '\t') || !std::getline(fields, wer, '\t')) {
+            fprintf(stderr, "%s: malformed entry for '%s' in %s\n", __func__, cpu.c_str(), path.c_str());
+            return false;
+        }
+
+        cal.model = model;
+        cal.n_threads = std::atoi(threads.c_str());
+        cal.rtf = std::atof(rtf.c_str());
+        cal.wer = std::atof(wer.c_str());
+        return cal.n_threads > 0 && !cal.model.empty();
+    }
+
+    return false;
+}
+
+bool save_stt_calibration(const std::string& path, const std::string& cpu, const SttCalibration& cal) {
+    // Keep the entries of other machines
+    std::vector<std::string> lines;
+    {
+        std::ifstream file(path);
+        std::string line;
+        while (std::getline(file, line)) {
+            if (!line.empty() && line.compare(0, line.find('\t'), cpu) != 0) {
+                lines.push_back(line);
+            }
+        }
+    }
+
+    std::ofstream file(path, std::ios::trunc);
+    if (!file) {
+        fprintf(stderr, "%s: cannot write %s\n", __func__, path.c_str());
+        return false;
+    }
+
+    for (const auto& line : lines) {
+        file << line << "\n";
+    }
+    file << cpu << "\t" << cal.model << "\t" << cal.n_threads << "\t" << cal.rtf << "\t" << cal.wer << "\n";
+
+    return (bool)file;
+}
+
+std::vector<std::string> find_whisper_models(const std::string& dir) {
+    namespace fs = std::filesystem;
+
+    std::vector<std::string> models;
+    std::error_code ec;
+    for (const auto& entry : fs::directory_iterator(dir.empty() ? "." : dir, ec)) {
+        const std::string name = entry.path().filename().string();
+        if (entry.is_regular_file() && name.compare(0, 5, "ggml-") == 0 &&
+            entry.path().extension() == ".bin") {
+            models.push_back(entry.path().string());
+        }
+    }
+    if (ec) {
+        fprintf(stderr, "%s: cannot list %s: %s\n", __func__, dir.c_str(), ec.message().c_str());
+    }
+
+    std::sort(models.begin(), models.end());
+    return models;
+}
+
+std::vector<int> calibration_thread_counts() {
+    const int n_hw = std::max(1, (int)std::thread::hardware_concurrency());
+
+    std::vector<int> counts;
+    for (int n = 1; n < n_hw; n *= 2) {
+        counts.push_back(n);
+    }
+    counts.push_back(n_hw);
+
+    return counts;
+}
+
+// Best of a few runs, so a background hiccup does not decide the result
+static const int N_TIMED_RUNS = 2;
+
+bool calibrate_stt(const std::vector<std::string>& models, const std::vector<int>& thread_counts,
+                   const std::vector<float>& pcm, const std::string& reference,
+                   const whisper_context_params& cparams, const whisper_full_params& wparams,
+                   double target_rtf, SttCalibration& best) {
+    const double audio_ms = 1000.0 * pcm.size() / WHISPER_SAMPLE_RATE;
+
+    std::vector<SttCalibration> results;
+
+    fprintf(stderr, "\n%-40s %8s %8s %8s\n", "model", "threads", "RTF", "WER");
+
+    for (const auto& model : models) {
+        whisper_context* ctx = whisper_init_from_file_with_params(model.c_str(), cparams);
+        if (!ctx) {
+            fprintf(stderr, "%s: skipping %s (failed to load)\n", __func__, model.c_str());
+            continue;
+        }
+
+        whisper_full_params params = wparams;
+
+        // Warm-up: first run allocates buffers and faults in the weights
+        params.n_threads = thread_counts.empty() ? 1 : thread_counts.back();
+        whisper_full(ctx, params, pcm.data(), (int)pcm.size());
+
+        for (int n_threads : thread_counts) {
+            params.n_threads = n_threads;
+
+            double best_ms = 0.0;
+            std::string text;
+            bool ok = true;
+
+            for (int run = 0; run < N_TIMED_RUNS && ok; run++) {
+                const auto t0 = std::chrono::steady_clock::now();
+                ok = whisper_full(ctx, params, pcm.data(), (int)pcm.size()) == 0;
+                const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+
+                if (run == 0 || ms < best_ms) {
+                    best_ms = ms;
+                }
+            }
+            if (!ok) {
+                fprintf(stderr, "%s: %s failed with %d threads\n", __func__, model.c_str(), n_threads);
+                continue;
+            }
+
+            const int n_segments = whisper_full_n_segments(ctx);
+            for (int i = 0; i < n_segments; i++) {
+                text += whisper_full_get_segment_text(ctx, i);
+            }
+
+            SttCalibration result;
+            result.model = model;
+            result.n_threads = n_threads;
+            result.rtf = real_time_factor(best_ms, audio_ms);
+            result.wer = word_error_rate(reference, text);
+            results.push_back(result);
+
+            const std::string name = std::filesystem::path(model).filename().string();
+            fprintf(stderr, "%-40s %8d %8.3f %7.1f%%\n", name.c_str(), n_threads, result.rtf, 100.0 * result.wer);
+        }
+
+        whisper_free(ctx);
+    }
+
+    if (results.empty()) {
+        return false;
+    }
+
+    // Most accurate among the fast enough; otherwise simply the fastest
+    const SttCalibration* pick = nullptr;
+    for (const auto& r : results) {
+        if (r.rtf > target_rtf) {
+            continue;
+        }
+        if (!pick || r.wer < pick->wer || (r.wer == pick->wer && r.rtf < pick->rtf)) {
+            pick = &r;
+        }
+    }
+    if (!pick) {
+        fprintf(stderr, "%s: no configuration reaches RTF %.2f, using the fastest\n", __func__, target_rtf);
+        for (const auto& r : results) {
+            if (!pick || r.rtf < pick->rtf) {
+                pick = &r;
+            }
+        }
+    }
+
+    best = *pick;
+    return true;
+}
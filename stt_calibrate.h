@@ -0,0 +1,39 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "whisper.h"
+
+// Whisper model and thread count chosen for one machine
+struct SttCalibration {
+    std::string model;
+    int n_threads = 0;
+    double rtf = 0.0;  // real-time factor measured on the calibration utterance
+    double wer = 0.0;  // word error rate on the calibration utterance
+};
+
+// Identifies the CPU a calibration was measured on (model name and number
+// of hardware threads), so one file can be shared across a mixed fleet
+std::string cpu_signature();
+
+// Calibration file: one line per CPU signature. Load returns false if
+// there is no entry for cpu; save replaces the entry for cpu.
+bool load_stt_calibration(const std::string& path, const std::string& cpu, SttCalibration& cal);
+bool save_stt_calibration(const std::string& path, const std::string& cpu, const SttCalibration& cal);
+
+// ggml-*.bin files in dir, sorted by name
+std::vector<std::string> find_whisper_models(const std::string& dir);
+
+// Thread counts worth trying on this machine: powers of two up to the
+// number of hardware threads, plus that number
+std::vector<int> calibration_thread_counts();
+
+// Transcribe pcm (16 kHz mono, known to say reference) with every model and
+// thread count. Picks the most accurate configuration whose real-time factor
+// is at most target_rtf (the faster one on ties), or the fastest overall if
+// none is fast enough. Returns false if no model could be run.
+bool calibrate_stt(const std::vector<std::string>& models, const std::vector<int>& thread_counts,
+                   const std::vector<float>& pcm, const std::string& reference,
+                   const whisper_context_params& cparams, const whisper_full_params& wparams,
+                   double target_rtf, SttCalibration& best);
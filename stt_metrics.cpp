@@ -0,0 +1,80 @@
+#include "stt_metrics.h"
+
+#include <cctype>
+#include <algorithm>
+
+std::vector<std::string> normalize_words(const std::string& text) {
+    std::vector<std::string> words;
+    std::string word;
+
+    for (unsigned char c : text) {
+        if (std::isalnum(c) || c == '\'' || c >= 0x80) {
+            word += (char)std::tolower(c);
+        } else if (!word.empty()) {
+            // Hyphens split too: "well-known" and "well known" must match
+            words.push_back(word);
+            word.clear();
+        }
+    }
+    if (!word.empty()) {
+        words.push_back(word);
+    }
+
+    // Quotes used as apostrophes at word edges
+    for (auto& w : words) {
+        while (!w.empty() && w.front() == '\'') w.erase(0, 1);
+        while (!w.empty() && w.back() == '\'') w.pop_back();
+    }
+    words.erase(std::remove(words.begin(), words.end(), std::string()), words.end());
+
+    return words;
+}
+
+int word_edit_distance(const std::vector<std::string>& ref, const std::vector<std::string>& hyp) {
+    // Single-row Levenshtein over words
+    std::vector<int> row(hyp.size() + 1);
+    for (size_t j = 0; j <= hyp.size(); j++) {
+        row[j] = (int)j;
+    }
+
+    for (size_t i = 1; i <= ref.size(); i++) {
+        int diag = row[0];
+        row[0] = (int)i;
+        for (size_t j = 1; j <= hyp.size(); j++) {
+            const int up = row[j];
+            const int cost = ref[i - 1] == hyp[j - 1] ? 0 : 1;
+            row[j] = std::min({row[j] + 1, row[j - 1] + 1, diag + cost});
+            diag = up;
+        }
+    }
+
+    return row[hyp.size()];
+}
+
+double word_error_rate(const std::string& ref, const std::string& hyp) {
+    const std::vector<std::string> ref_words = normalize_words(ref);
+    const std::vector<std::string> hyp_words = normalize_words(hyp);
+
+    const int errors = word_edit_distance(ref_words, hyp_words);
+    if (ref_words.empty()) {
+        return (double)errors;
+    }
+
+    return (double)errors / ref_words.size();
+}
+
+double transcript_similarity(const std::string& a, const std::string& b) {
+    const std::vector<std::string> a_words = normalize_words(a);
+    const std::vector<std::string> b_words = normalize_words(b);
+
+    const size_t n = std::max(a_words.size(), b_words.size());
+    if (n == 0) {
+        return 1.0;
+    }
+
+    return 1.0 - (double)word_edit_distance(a_words, b_words) / n;
+}
+
+double real_time_factor(double processing_ms, double audio_ms) {
+    return audio_ms > 0.0 ? processing_ms / audio_ms : 0.0;
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// Lowercase words with punctuation removed (apostrophes kept), so
+// transcripts compare on what was said rather than how it was written
+std::vector<std::string> normalize_words(const std::string& text);
+
+// Word-level edit distance (substitutions + deletions + insertions)
+int word_edit_distance(const std::vector<std::string>& ref, const std::vector<std::string>& hyp);
+
+// Word error rate of hyp against ref: edit distance / reference words.
+// 0 when both are empty, 1 per inserted word when only ref is empty.
+double word_error_rate(const std::string& ref, const std::string& hyp);
+
+// Word-level similarity of two transcripts in [0, 1]: 1 - edit distance /
+// longer word count. 1 when they say the same thing.
+double transcript_similarity(const std::string& a, const std::string& b);
+
+// Real-time factor: processing time over audio duration (< 1 is faster
+// than real time)
+double real_time_factor(double processing_ms, double audio_ms);
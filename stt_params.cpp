@@ -0,0 +1,22 @@
+#include "stt_params.h"
+
+whisper_context_params make_whisper_context_params() {
+    whisper_context_params cparams = whisper_context_default_params();
+    cparams.use_gpu = true;
+    cparams.flash_attn = true;
+    return cparams;
+}
+
+whisper_full_params make_whisper_params(int n_threads) {
+    whisper_full_params wparams = whisper_full_default_params(WHISPER_SAMPLING_GREEDY);
+    wparams.print_progress = false;
+    wparams.print_special = false;
+    wparams.print_realtime = false;
+    wparams.print_timestamps = false;
+    wparams.translate = false;
+    wparams.single_segment = true;
+    wparams.no_context = true;
+    wparams.language = "en";
+    wparams.n_threads = n_threads;
+    return wparams;
+}
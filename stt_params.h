@@ -0,0 +1,13 @@
+#pragma once
+
+#include <cstddef>
+
+#include "whisper.h"
+
+// whisper ignores input shorter than 1 s, so shorter audio is padded to this
+const size_t STT_MIN_SAMPLES = WHISPER_SAMPLE_RATE * 1100 / 1000;
+
+// Whisper settings shared by voice_chat and stt_bench, so benchmark results
+// carry over to the game
+whisper_context_params make_whisper_context_params();
+whisper_full_params make_whisper_params(int n_threads);
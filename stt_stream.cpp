@@ -0,0 +1,201 @@
+#include "stt_stream.h"
+#include "stt_params.h"
+
+#include <cstdio>
+#include <algorithm>
+
+// Tokens ending this close to the newest audio may still change
+static const int64_t COMMIT_GUARD_SAMPLES = WHISPER_SAMPLE_RATE / 2;
+
+// Prompt with at most this many committed tokens
+static const size_t MAX_PROMPT_TOKENS = 64;
+
+// One encoder position per 20 ms (two 10 ms mel frames)
+static const size_t SAMPLES_PER_AUDIO_CTX = WHISPER_SAMPLE_RATE / 50;
+
+// Full 30 s context of the released models
+static const int MAX_AUDIO_CTX = 1500;
+
+// Extra positions so the decoder sees some silence after the last word;
+// with a context cut flush to the audio it tends to drop the final word
+static const int AUDIO_CTX_PADDING = 64;
+
+int whisper_audio_ctx_for(size_t n_samples) {
+    int audio_ctx = (int)((n_samples + SAMPLES_PER_AUDIO_CTX - 1) / SAMPLES_PER_AUDIO_CTX) + AUDIO_CTX_PADDING;
+
+    // Round up so similar lengths share the same graph shape
+    audio_ctx = (audio_ctx + 31) / 32 * 32;
+
+    return audio_ctx >= MAX_AUDIO_CTX ? 0 : audio_ctx;
+}
+
+StreamingTranscriber::StreamingTranscriber(whisper_context* ctx, const whisper_full_params& wparams, int step_ms, int length_ms)
+    : m_ctx(ctx), m_wparams(wparams) {
+    m_step_samples = (size_t)WHISPER_SAMPLE_RATE * step_ms / 1000;
+    m_length_samples = (size_t)WHISPER_SAMPLE_RATE * length_ms / 1000;
+
+    // Token end times decide how much audio a commit covers
+    m_wparams.token_timestamps = true;
+}
+
+void StreamingTranscriber::begin(uint64_t pos) {
+    m_active = true;
+    m_committed_pos = pos;
+    m_committed_text.clear();
+    m_committed_ids.clear();
+    m_hypothesis.clear();
+    m_n_decodes = 0;
+}
+
+std::string StreamingTranscriber::partial_text() const {
+    std::string text = m_committed_text;
+    for (const auto& token : m_hypothesis) {
+        text += token.text;
+    }
+    return text;
+}
+
+bool StreamingTranscriber::decode(whisper_state* state, const float* samples, size_t n_samples, std::vector<Token>& tokens) {
+    tokens.clear();
+
+    m_pcm.assign(samples, samples + n_samples);
+    if (m_pcm.size() < STT_MIN_SAMPLES) {
+        m_pcm.resize(STT_MIN_SAMPLES, 0.0f);
+    }
+
+    // Condition on what is already committed so the tail continues it
+    whisper_full_params wparams = m_wparams;
+    const size_t n_prompt = std::min(m_committed_ids.size(), MAX_PROMPT_TOKENS);
+    if (n_prompt > 0) {
+        wparams.prompt_tokens = m_committed_ids.data() + m_committed_ids.size() - n_prompt;
+        wparams.prompt_n_tokens = (int)n_prompt;
+    }
+
+    if (m_fit_audio_ctx) {
+        wparams.audio_ctx = whisper_audio_ctx_for(m_pcm.size());
+    }
+
+    m_n_decodes++;
+    if (whisper_full_with_state(m_ctx, state, wparams, m_pcm.data(), (int)m_pcm.size()) != 0) {
+        fprintf(stderr, "%s: whisper_full failed\n", __func__);
+        return false;
+    }
+
+    const whisper_token token_eot = whisper_token_eot(m_ctx);
+
+    const int n_segments = whisper_full_n_segments_from_state(state);
+    for (int i = 0; i < n_segments; i++) {
+        const int n_tokens = whisper_full_n_tokens_from_state(state, i);
+        for (int j = 0; j < n_tokens; j++) {
+            const whisper_token id = whisper_full_get_token_id_from_state(state, i, j);
+            if (id >= token_eot) {
+                continue;  // timestamps and other special tokens
+            }
+
+            const whisper_token_data data = whisper_full_get_token_data_from_state(state, i, j);
+            const int64_t t1 = std::min<int64_t>(data.t1 * WHISPER_SAMPLE_RATE / 100, n_samples);
+
+            tokens.push_back({id, whisper_full_get_token_text_from_state(m_ctx, state, i, j), t1});
+        }
+    }
+
+    return true;
+}
+
+bool StreamingTranscriber::step(whisper_state* state, uint64_t pos, const float* samples, size_t n_samples) {
+    if (!m_active) {
+        return false;
+    }
+
+    if (pos > m_committed_pos) {
+        // Audio was lost before it could be committed
+        m_committed_pos = pos;
+        m_hypothesis.clear();
+    }
+
+    // Only the newest length_ms fit in one window
+    if (n_samples > m_length_samples) {
+        samples += n_samples - m_length_samples;
+        pos += n_samples - m_length_samples;
+        n_samples = m_length_samples;
+        m_committed_pos = pos;
+        m_hypothesis.clear();
+    }
+
+    if (n_samples < (size_t)WHISPER_SAMPLE_RATE) {
+        return true;  // not enough new audio to say anything useful yet
+    }
+
+    std::vector<Token> tokens;
+    if (!decode(state, samples, n_samples, tokens)) {
+        return false;
+    }
+
+    // Longest prefix the previous decode agrees with
+    size_t n_agree = 0;
+    while (n_agree < tokens.size() && n_agree < m_hypothesis.size() && tokens[n_agree].id == m_hypothesis[n_agree].id) {
+        n_agree++;
+    }
+
+    const int64_t commit_limit = (int64_t)n_samples - COMMIT_GUARD_SAMPLES;
+
+    size_t n_commit = 0;
+    while (n_commit < n_agree && tokens[n_commit].t1 <= commit_limit) {
+        n_commit++;
+    }
+
+    // The window is about to overflow: commit what is old enough even
+    // without agreement, rather than losing it
+    if (n_samples + m_step_samples > m_length_samples) {
+        while (n_commit < tokens.size() && tokens[n_commit].t1 <= commit_limit) {
+            n_commit++;
+        }
+    }
+
+    // Cut at a word boundary so the next window does not start mid-word
+    while (n_commit > 0 && n_commit < tokens.size() && tokens[n_commit].text.compare(0, 1, " ") != 0) {
+        n_commit--;
+    }
+
+    for (size_t i = 0; i < n_commit; i++) {
+        m_committed_text += tokens[i].text;
+        m_committed_ids.push_back(tokens[i].id);
+    }
+
+    if (n_commit > 0) {
+        m_committed_pos = pos + (uint64_t)std::max<int64_t>(tokens[n_commit - 1].t1, 0);
+    }
+
+    m_hypothesis.assign(tokens.begin() + n_commit, tokens.end());
+
+    return true;
+}
+
+bool StreamingTranscriber::finish(whisper_state* state, uint64_t pos, const float* samples, size_t n_samples, std::string& transcript) {
+    m_active = false;
+    transcript = m_committed_text;
+
+    // Only what was dropped from the front is skipped
+    if (pos < m_committed_pos) {
+        const size_t skip = (size_t)std::min<uint64_t>(m_committed_pos - pos, n_samples);
+        samples += skip;
+        n_samples -= skip;
+    }
+
+    if (n_samples == 0) {
+        return true;
+    }
+
+    std::vector<Token> tokens;
+    if (!decode(state, samples, n_samples, tokens)) {
+        return false;
+    }
+
+    for (const auto& token : tokens) {
+        transcript += token.text;
+    }
+
+    m_hypothesis.clear();
+
+    return true;
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "whisper.h"
+
+// Encoder context (whisper_full_params::audio_ctx) covering n_samples of
+// 16 kHz audio plus some headroom. The encoder normally always processes
+// 30 s (1500 positions); short utterances need only a fraction of that.
+// Returns 0 (the model default) when the audio needs the full context.
+int whisper_audio_ctx_for(size_t n_samples);
+
+// Streaming transcription of one utterance at a time.
+//
+// While the player is speaking, step() re-decodes the audio after the last
+// committed point (at most length_ms of it). Tokens that two consecutive
+// decodes agree on, and that end well before the newest audio, are
+// committed: their text is final and the audio they cover is dropped from
+// later windows. At end of speech finish() only has the short tail left to
+// decode, so the transcript is ready almost immediately.
+//
+// Decoding uses the whisper_state passed in (e.g. the STT worker's), so
+// all calls for one utterance must come from the thread that owns it.
+class StreamingTranscriber {
+public:
+    // wparams is copied; token timestamps and prompt tokens are managed here
+    StreamingTranscriber(whisper_context* ctx, const whisper_full_params& wparams, int step_ms, int length_ms);
+
+    // Shrink the encoder context to each window (see whisper_audio_ctx_for)
+    void set_fit_audio_ctx(bool fit) { m_fit_audio_ctx = fit; }
+
+    // Start a new utterance whose audio begins at sample position pos
+    void begin(uint64_t pos);
+
+    bool active() const { return m_active; }
+
+    // Decode audio whose first sample is at sample position pos (normally
+    // committed_pos(), later if the capture buffer dropped some) and commit
+    // the stable prefix. Returns false if whisper failed.
+    bool step(whisper_state* state, uint64_t pos, const float* samples, size_t n_samples);
+
+    // Decode the remaining audio and return the full transcript
+    bool finish(whisper_state* state, uint64_t pos, const float* samples, size_t n_samples, std::string& transcript);
+
+    uint64_t committed_pos() const { return m_committed_pos; }
+    const std::string& committed_text() const { return m_committed_text; }
+
+    // Committed text followed by the latest (unstable) hypothesis
+    std::string partial_text() const;
+
+    // Number of whisper runs for the current utterance
+    int decode_count() const { return m_n_decodes; }
+
+private:
+    struct Token {
+        whisper_token id;
+        std::string text;
+        int64_t t1;  // end time in samples, relative to the window start
+    };
+
+    bool decode(whisper_state* state, const float* samples, size_t n_samples, std::vector<Token>& tokens);
+
+    whisper_context* m_ctx;
+    whisper_full_params m_wparams;
+    size_t m_step_samples;
+    size_t m_length_samples;
+
+    bool m_fit_audio_ctx = false;
+
+    bool m_active = false;
+    uint64_t m_committed_pos = 0;
+    std::string m_committed_text;
+    std::vector<whisper_token> m_committed_ids;  // fed back as prompt
+    std::vector<Token> m_hypothesis;             // unstable tail of the last decode
+    std::vector<float> m_pcm;                    // padded whisper input
+    int m_n_decodes = 0;
+};
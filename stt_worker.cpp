@@ -0,0 +1,159 @@
+#include "stt_worker.h"
+
+#include <cstdio>
+#include <algorithm>
+
+SttWorker::SttWorker(size_t max_queue) : m_max_queue(max_queue) {
+}
+
+SttWorker::~SttWorker() {
+    stop();
+
+    if (m_ctx) {
+        whisper_free(m_ctx);
+        m_ctx = nullptr;
+    }
+}
+
+bool SttWorker::init(const std::string& model_path, const whisper_context_params& cparams, int n_threads) {
+    // Weights only: each worker thread gets its own decoding state
+    m_ctx = whisper_init_from_file_with_params_no_state(model_path.c_str(), cparams);
+    if (!m_ctx) {
+        fprintf(stderr, "%s: failed to load whisper model '%s'\n", __func__, model_path.c_str());
+        return false;
+    }
+
+    m_stop = false;
+
+    for (int i = 0; i < std::max(n_threads, 1); i++) {
+        std::promise<bool> ready;
+        std::future<bool> created = ready.get_future();
+        m_threads.emplace_back(&SttWorker::run, this, std::move(ready));
+
+        if (!created.get()) {
+            fprintf(stderr, "%s: failed to create whisper state %d\n", __func__, i);
+            stop();
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void SttWorker::stop() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_cv.notify_all();
+
+    for (auto& thread : m_threads) {
+        if (thread.joinable()) {
+            thread.join();
+        }
+    }
+    m_threads.clear();
+}
+
+bool SttWorker::submit(int session, SttJob job, std::future<SttResult>& result) {
+    Task task(std::move(job));
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_stop || m_threads.empty()) {
+            fprintf(stderr, "%s: worker is not running\n", __func__);
+            return false;
+        }
+        if (m_n_queued >= m_max_queue) {
+            fprintf(stderr, "%s: queue full (%zu jobs)\n", __func__, m_n_queued);
+            return false;
+        }
+
+        result = task.get_future();
+
+        Session& s = m_sessions[session];
+        if (s.queue.empty() && !s.running) {
+            m_ready.push_back(session);
+        }
+        s.queue.push_back(std::move(task));
+        m_n_queued++;
+    }
+    m_cv.notify_one();
+
+    return true;
+}
+
+size_t SttWorker::pending() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_n_queued + m_n_running;
+}
+
+void SttWorker::run(std::promise<bool> ready) {
+    if (m_thread_start) {
+        m_thread_start();
+    }
+
+    // Created here, after m_thread_start, so its buffers are first touched
+    // by the thread (and cores) that uses them
+    whisper_state* state = whisper_init_state(m_ctx);
+    ready.set_value(state != nullptr);
+    if (!state) {
+        return;
+    }
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    while (true) {
+        // Drain the queue before stopping so no future is left hanging
+        m_cv.wait(lock, [this] { return !m_ready.empty() || (m_stop && m_n_queued == 0); });
+
+        if (m_ready.empty()) {
+            break;
+        }
+
+        // Next session in turn
+        const int id = m_ready.front();
+        m_ready.pop_front();
+
+        Session& s = m_sessions[id];
+        Task task = std::move(s.queue.front());
+        s.queue.pop_front();
+        s.running = true;
+        m_n_queued--;
+        m_n_running++;
+
+        lock.unlock();
+        task(m_ctx, state);
+        lock.lock();
+
+        m_n_running--;
+
+        // Back of the line if it has more work, forget it otherwise
+        Session& done = m_sessions[id];
+        done.running = false;
+        if (!done.queue.empty()) {
+            m_ready.push_back(id);
+            m_cv.notify_one();
+        } else {
+            m_sessions.erase(id);
+        }
+
+        if (m_stop && m_n_queued == 0) {
+            m_cv.notify_all();
+        }
+    }
+
+    lock.unlock();
+    whisper_free_state(state);
+}
+
+std::string whisper_state_text(whisper_state* state) {
+    std::string text;
+
+    const int n_segments = whisper_full_n_segments_from_state(state);
+    for (int i = 0; i < n_segments; i++) {
+        text += whisper_full_get_segment_text_from_state(state, i);
+    }
+
+    return text;
+}
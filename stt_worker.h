@@ -0,0 +1,91 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "whisper.h"
+
+// Outcome of one transcription job
+struct SttResult {
+    bool ok = false;
+    std::string text;
+};
+
+// A job runs on a worker thread with the shared model and that worker's
+// own decoding state
+using SttJob = std::function<SttResult(whisper_context* ctx, whisper_state* state)>;
+
+// Runs whisper on dedicated threads so capture and endpointing never wait
+// for inference. The model is loaded once; each thread has its own
+// whisper_state (KV cache and compute buffers), which is all a concurrent
+// utterance costs.
+//
+// Jobs belong to a session (one per player). A session's jobs run in
+// submission order and never two at a time, so they may share per-session
+// data such as a StreamingTranscriber. Sessions with queued jobs are served
+// round-robin, so one talkative player cannot starve the others. The queue
+// is bounded; results come back through futures.
+class SttWorker {
+public:
+    explicit SttWorker(size_t max_queue = 8);
+    ~SttWorker();
+
+    // Run on each worker thread before its first job, e.g. to pin it to
+    // cores (the OpenMP threads whisper starts from it inherit the
+    // affinity). Set before init().
+    void set_thread_start(std::function<void()> fn) { m_thread_start = std::move(fn); }
+
+    // Load the model and start n_threads workers
+    bool init(const std::string& model_path, const whisper_context_params& cparams, int n_threads = 1);
+
+    // Finish the queued jobs and stop the threads
+    void stop();
+
+    // Model, for read-only queries (vocabulary, n_mels, ...) from other threads
+    whisper_context* context() const { return m_ctx; }
+
+    // Queue a job for a session. Returns false if the queue is full or the
+    // worker stopped.
+    bool submit(int session, SttJob job, std::future<SttResult>& result);
+    bool submit(SttJob job, std::future<SttResult>& result) { return submit(0, std::move(job), result); }
+
+    // Jobs queued or running
+    size_t pending() const;
+
+    int n_threads() const { return (int)m_threads.size(); }
+
+private:
+    using Task = std::packaged_task<SttResult(whisper_context*, whisper_state*)>;
+
+    struct Session {
+        std::deque<Task> queue;
+        bool running = false;
+    };
+
+    // Creates the thread's whisper_state and reports whether that worked
+    // through ready before taking jobs
+    void run(std::promise<bool> ready);
+
+    size_t m_max_queue;
+    std::function<void()> m_thread_start;
+    whisper_context* m_ctx = nullptr;
+
+    std::vector<std::thread> m_threads;
+    mutable std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::map<int, Session> m_sessions;
+    std::deque<int> m_ready;  // sessions with queued jobs and none running, in turn order
+    size_t m_n_queued = 0;
+    size_t m_n_running = 0;
+    bool m_stop = false;
+};
+
+// Concatenated segment text of the last whisper_full_with_state() run
+std::string whisper_state_text(whisper_state* state);
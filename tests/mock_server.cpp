@@ -0,0 +1,170 @@
+#include "mock_server.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+
+static bool sendAll(int fd, const std::string& data) {
+    size_t sent = 0;
+    while (sent < data.size()) {
+        const ssize_t n = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if (n <= 0) {
+            return false;
+        }
+        sent += (size_t)n;
+    }
+    return true;
+}
+
+static std::string chunk(const std::string& data) {
+    char size[32];
+    snprintf(size, sizeof(size), "%zx\r\n", data.size());
+    return size + data + "\r\n";
+}
+
+static std::string lower(std::string str) {
+    std::transform(str.begin(), str.end(), str.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+    return str;
+}
+
+// Reads one request; false if the connection closed first
+static bool readRequest(int fd, std::string& body) {
+    std::string data;
+    char buffer[4096];
+
+    size_t headerEnd;
+    while ((headerEnd = data.find("\r\n\r\n")) == std::string::npos) {
+        const ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+        if (n <= 0) {
+            return false;
+        }
+        data.append(buffer, (size_t)n);
+    }
+
+    const std::string headers = lower(data.substr(0, headerEnd));
+    size_t length = 0;
+    const size_t field = headers.find("\r\ncontent-length:");
+    if (field != std::string::npos) {
+        length = std::stoul(headers.substr(field + 17));
+    }
+    if (headers.find("\r\nexpect: 100-continue") != std::string::npos && !sendAll(fd, "HTTP/1.1 100 Continue\r\n\r\n")) {
+        return false;
+    }
+
+    body = data.substr(headerEnd + 4);
+    while (body.size() < length) {
+        const ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+        if (n <= 0) {
+            return false;
+        }
+        body.append(buffer, (size_t)n);
+    }
+    return true;
+}
+
+MockServer::MockServer(MockHandler handler) : m_handler(std::move(handler)) {
+    m_listenFd = socket(AF_INET, SOCK_STREAM, 0);
+
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = 0;
+    socklen_t size = sizeof(address);
+    if (m_listenFd < 0 || bind(m_listenFd, (sockaddr*)&address, sizeof(address)) != 0 ||
+        listen(m_listenFd, 16) != 0 || getsockname(m_listenFd, (sockaddr*)&address, &size) != 0) {
+        perror("mock server");
+        return;
+    }
+
+    m_url = "http://127.0.0.1:" + std::to_string(ntohs(address.sin_port)) + "/v1/chat/completions";
+    m_acceptThread = std::thread(&MockServer::acceptLoop, this);
+}
+
+MockServer::~MockServer() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+        for (int fd : m_connections) {
+            shutdown(fd, SHUT_RDWR);
+        }
+    }
+    m_stopped.notify_all();
+
+    if (m_listenFd >= 0) {
+        shutdown(m_listenFd, SHUT_RDWR);
+    }
+    if (m_acceptThread.joinable()) {
+        m_acceptThread.join();
+    }
+    for (std::thread& thread : m_threads) {
+        thread.join();
+    }
+    if (m_listenFd >= 0) {
+        close(m_listenFd);
+    }
+}
+
+std::string MockServer::completion(const std::string& content) {
+    return "{\"choices\":[{\"index\":0,\"message\":{\"role\":\"assistant\",\"content\":\"" + content + "\"}}]}";
+}
+
+std::string MockServer::delta(const std::string& content) {
+    return "{\"choices\":[{\"index\":0,\"delta\":{\"content\":\"" + content + "\"}}]}";
+}
+
+void MockServer::acceptLoop() {
+    while (true) {
+        const int fd = accept(m_listenFd, nullptr, nullptr);
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (fd < 0 || m_stopping) {
+            if (fd >= 0) {
+                close(fd);
+            }
+            return;
+        }
+        m_connections.push_back(fd);
+        m_threads.emplace_back(&MockServer::serve, this, fd);
+    }
+}
+
+bool MockServer::wait(long ms) {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    return !m_stopped.wait_for(lock, std::chrono::milliseconds(ms), [this] { return m_stopping; });
+}
+
+void MockServer::serve(int fd) {
+    std::string body;
+    if (readRequest(fd, body)) {
+        const MockResponse response = m_handler(m_requests++, body);
+
+        bool open = wait(response.delayMs);
+        const bool stream = !response.events.empty();
+        std::string head = "HTTP/1.1 " + std::to_string(response.status) + " Mock\r\n";
+        head += stream ? "Content-Type: text/event-stream\r\n" : "Content-Type: application/json\r\n";
+        head += "Transfer-Encoding: chunked\r\nConnection: close\r\n\r\n";
+        open = open && sendAll(fd, head);
+
+        if (!response.body.empty()) {
+            open = open && sendAll(fd, chunk(response.body));
+        }
+        for (size_t i = 0; i < response.events.size() && open; i++) {
+            if (i > 0) {
+                open = wait(response.eventDelayMs);
+            }
+            open = open && sendAll(fd, chunk("data: " + response.events[i] + "\n\n"));
+        }
+        if (open && !response.drop) {
+            sendAll(fd, "0\r\n\r\n");
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_connections.erase(std::find(m_connections.begin(), m_connections.end(), fd));
+    close(fd);
+}
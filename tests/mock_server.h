@@ -0,0 +1,61 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// What the mock server answers to one request
+struct MockResponse {
+    int status = 200;
+    std::string body;                 // sent in one piece, or
+    std::vector<std::string> events;  // sent as server-sent events, one "data:" each
+    long delayMs = 0;                 // before the response starts
+    long eventDelayMs = 0;            // between events
+    bool drop = false;                // close the connection before the body is complete
+};
+
+// Called for each request with its number (from 0) and body
+using MockHandler = std::function<MockResponse(int index, const std::string& body)>;
+
+// Plain HTTP/1.1 server on a free localhost port, standing in for the chat
+// completions API. Responses are chunked and close the connection.
+class MockServer {
+public:
+    explicit MockServer(MockHandler handler);
+    ~MockServer();
+
+    MockServer(const MockServer&) = delete;
+    MockServer& operator=(const MockServer&) = delete;
+
+    std::string url() const { return m_url; }
+
+    // Requests received so far
+    int requests() const { return m_requests; }
+
+    // The body of a completion with content, and a streamed token event
+    static std::string completion(const std::string& content);
+    static std::string delta(const std::string& content);
+
+private:
+    void acceptLoop();
+    void serve(int fd);
+
+    // Sleeps for ms, or less if the server is stopped; returns false if it was
+    bool wait(long ms);
+
+    MockHandler m_handler;
+    std::string m_url;
+    int m_listenFd = -1;
+    std::atomic_int m_requests{0};
+
+    std::mutex m_mutex;
+    std::condition_variable m_stopped;
+    bool m_stopping = false;
+    std::vector<int> m_connections;
+    std::vector<std::thread> m_threads;
+    std::thread m_acceptThread;
+};
@@ -0,0 +1,197 @@
+// Checks JsonExtractor against nlohmann::json (vendored with libpiper):
+// the same values must come out and the same documents must be rejected,
+// whatever the split points between feed() calls.
+
+#include "json_extract.h"
+#include "json.hpp"
+#include "test_util.h"
+
+#include <random>
+#include <string>
+#include <vector>
+
+using nlohmann::json;
+
+static const std::vector<std::string> PATHS = {"choices.0.message.content", "choices.0.delta.content", "error"};
+
+// The string at path, with found set if anything is there
+static std::string lookup(const json& doc, const std::string& path, bool& found) {
+    const json* node = &doc;
+    found = false;
+
+    size_t start = 0;
+    while (start <= path.size()) {
+        size_t end = path.find('.', start);
+        if (end == std::string::npos) {
+            end = path.size();
+        }
+        const std::string key = path.substr(start, end - start);
+        start = end + 1;
+
+        if (node->is_array()) {
+            if (key.empty() || key.find_first_not_of("0123456789") != std::string::npos) {
+                return "";
+            }
+            const size_t index = std::stoul(key);
+            if (index >= node->size()) {
+                return "";
+            }
+            node = &(*node)[index];
+        } else if (node->is_object() && node->contains(key)) {
+            node = &(*node)[key];
+        } else {
+            return "";
+        }
+    }
+
+    found = true;
+    return node->is_string() ? node->get<std::string>() : "";
+}
+
+// Feed doc in random pieces; returns feed() && complete()
+static bool parse_split(JsonExtractor& parser, const std::string& doc, std::mt19937& rng) {
+    parser.reset();
+    bool ok = true;
+    size_t pos = 0;
+    while (pos < doc.size()) {
+        const size_t n = std::min<size_t>(1 + rng() % 7, doc.size() - pos);
+        ok = parser.feed(doc.data() + pos, n) && ok;
+        pos += n;
+    }
+    return ok && parser.complete();
+}
+
+static void check_document(const std::string& doc, std::mt19937& rng) {
+    const bool valid = json::accept(doc);
+
+    // value() collects the strings of all paths in document order, so it
+    // is only compared when one path is there
+    std::string expected;
+    bool found[3] = {false, false, false};
+    int n_found = 0;
+    if (valid) {
+        const json parsed = json::parse(doc);
+        for (size_t p = 0; p < PATHS.size(); p++) {
+            expected += lookup(parsed, PATHS[p], found[p]);
+            n_found += found[p];
+        }
+    }
+
+    JsonExtractor parser(PATHS);
+    for (int trial = 0; trial < 10; trial++) {
+        const bool ok = parse_split(parser, doc, rng);
+        if (ok != valid) {
+            fprintf(stderr, "%s: expected %s\n", doc.c_str(), valid ? "valid" : "invalid");
+            CHECK(ok == valid);
+            return;
+        }
+        if (valid) {
+            for (size_t p = 0; p < PATHS.size(); p++) {
+                CHECK(parser.found(p) == found[p]);
+            }
+            if (n_found <= 1) {
+                CHECK(parser.value() == expected);
+            }
+        }
+    }
+}
+
+// Random documents around the reply paths
+static json random_value(std::mt19937& rng, int depth) {
+    static const std::vector<std::string> keys = {"choices", "message", "delta", "content", "error", "role", "x"};
+    static const std::vector<std::string> strings = {
+        "", "plain", "quote \" backslash \\ slash /", "line\nbreak\ttab", "\xc3\xa9\xe4\xb8\xad\xf0\x9f\x98\x80",
+        std::string("nul\x01" "ctl", 7),
+    };
+
+    switch (depth > 3 ? rng() % 4 : rng() % 6) {
+        case 0: return strings[rng() % strings.size()];
+        case 1: {
+            std::uniform_real_distribution<double> number(-1e6, 1e6);
+            return rng() % 2 ? json(number(rng)) : json((long)(rng() % 2000) - 1000);
+        }
+        case 2: return rng() % 2 == 0;
+        case 3: return nullptr;
+        case 4: {
+            json array = json::array();
+            const int n = rng() % 4;
+            for (int i = 0; i < n; i++) {
+                array.push_back(random_value(rng, depth + 1));
+            }
+            return array;
+        }
+        default: {
+            json object = json::object();
+            const int n = rng() % 4;
+            for (int i = 0; i < n; i++) {
+                object[keys[rng() % keys.size()]] = random_value(rng, depth + 1);
+            }
+            return object;
+        }
+    }
+}
+
+int main() {
+    std::mt19937 rng(42);
+
+    const std::vector<std::string> documents = {
+        R"({"id":"x","choices":[{"index":0,"message":{"role":"assistant","content":"Hi \"there\"é中😀 \/ \\ end"}}]})",
+        R"({"content":"decoy","choices":[{"delta":{"content":"tok"}},{"delta":{"content":"second"}}]})",
+        R"({"choices":[{"delta":{"role":"assistant","content":""},"finish_reason":null}]})",
+        R"({"choices":[{"delta":{"tool_calls":[{"content":"x"}],"content":null}}],"usage":{"a":1.5e-3,"b":true,"c":[],"d":{}}})",
+        R"({"error":{"message":"bad \"key\"","code":401}})",
+        R"( { "choices" : [ { "message" : { "content" : "spaced" } } ] } )",
+        R"({"choices":[[],{"message":{"content":"not first"}}]})",
+        R"({"n":[0,-0,1,-12,0.5,-0.25e+10,1E5,2e-3,10.01E-01]})",
+        R"({"k":[true,false,null]})",
+
+        // Invalid
+        R"({"a":nope})",
+        R"({"a":1.2.3e-,"b":-})",
+        R"({"a":tru})",
+        R"({"a":truex})",
+        R"({"a":nul})",
+        R"({"a":True})",
+        R"({"a":01})",
+        R"({"a":-})",
+        R"({"a":1.})",
+        R"({"a":.5})",
+        R"({"a":1e})",
+        R"({"a":1e+})",
+        R"({"a":+1})",
+        R"({"a":0x10})",
+        R"({"a":1,})",
+        R"({"a" 1})",
+        R"({"a":"x
+y"})",
+        R"({"a":"\q"})",
+        R"({"a":"\u12g4"})",
+        R"([1 2])",
+        R"({"a":1}})",
+        "<html>",
+    };
+    for (const std::string& doc : documents) {
+        check_document(doc, rng);
+    }
+
+    for (int i = 0; i < 500; i++) {
+        json doc = random_value(rng, 0);
+        if (rng() % 2) {
+            // Put a reply where the paths look
+            doc = json::object();
+            doc["choices"] = json::array({json::object()});
+            doc["choices"][0][rng() % 2 ? "message" : "delta"] = {{"content", random_value(rng, 2)}};
+        }
+        if (!doc.is_object() && !doc.is_array()) {
+            continue;  // top-level scalars only complete at a delimiter
+        }
+        check_document(doc.dump(rng() % 2 ? -1 : 1), rng);
+    }
+
+    // Lone surrogates become U+FFFD
+    JsonExtractor parser({"c"});
+    CHECK(parser.feed(R"({"c":"a\ud83dx\udc00😀"})") && parser.complete());
+    CHECK(parser.value() == "a\xef\xbf\xbdx\xef\xbf\xbd\xf0\x9f\x98\x80");
+
+    return test_result("test_json_extract");
+}
@@ -0,0 +1,151 @@
+// Cross-checks MelStream against a direct implementation of whisper.cpp's
+// front-end: a plain DFT per frame instead of the mixed-radix FFT, over
+// the whole utterance at once instead of frame by frame.
+
+#include "mel_stream.h"
+#include "test_util.h"
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <random>
+#include <vector>
+
+static const double PI = 3.14159265358979323846;
+static const int N_BINS = MelStream::N_FFT / 2 + 1;
+
+// Power spectrum of one windowed frame by the DFT definition
+static std::vector<double> dft_power(const float* frame) {
+    std::vector<double> power(N_BINS);
+    for (int k = 0; k < N_BINS; k++) {
+        std::complex<double> sum = 0.0;
+        for (int n = 0; n < MelStream::N_FFT; n++) {
+            const double hann = 0.5 * (1.0 - std::cos(2.0 * PI * n / MelStream::N_FFT));
+            sum += frame[n] * hann * std::polar(1.0, -2.0 * PI * k * n / MelStream::N_FFT);
+        }
+        power[k] = std::norm(sum);
+    }
+    return power;
+}
+
+static double log_mel(const std::vector<float>& filters, const std::vector<double>& power, int mel) {
+    double sum = 0.0;
+    for (int k = 0; k < N_BINS; k++) {
+        sum += filters[mel * N_BINS + k] * power[k];
+    }
+    return std::log10(std::max(sum, 1e-10));
+}
+
+// whisper's log_mel_spectrogram: reflect padding of 200 at the start, 30 s
+// of zeros at the end, frames past the input left silent, then clamped to
+// 8 below the maximum and scaled. Layout [n_mel][n_len].
+static std::vector<float> reference_mel(const std::vector<float>& pcm, const std::vector<float>& filters, int n_mel,
+                                        int& n_len) {
+    const int pad = MelStream::N_FFT / 2;
+
+    std::vector<float> padded(pcm.size() + 30 * MelStream::SAMPLE_RATE + MelStream::N_FFT, 0.0f);
+    std::copy(pcm.begin(), pcm.end(), padded.begin() + pad);
+    for (int i = 0; i < pad; i++) {
+        padded[i] = pad - i < (int)pcm.size() ? pcm[pad - i] : 0.0f;
+    }
+
+    n_len = (int)((padded.size() - MelStream::N_FFT) / MelStream::HOP);
+
+    std::vector<float> mel((size_t)n_mel * n_len);
+    for (int i = 0; i < n_len; i++) {
+        const bool silent = (size_t)i * MelStream::HOP >= pcm.size() + pad;
+        const std::vector<double> power = silent ? std::vector<double>(N_BINS, 0.0)
+                                                 : dft_power(padded.data() + (size_t)i * MelStream::HOP);
+        for (int j = 0; j < n_mel; j++) {
+            mel[(size_t)j * n_len + i] = (float)log_mel(filters, power, j);
+        }
+    }
+
+    const float floor = *std::max_element(mel.begin(), mel.end()) - 8.0f;
+    for (float& v : mel) {
+        v = (std::max(v, floor) + 4.0f) / 4.0f;
+    }
+    return mel;
+}
+
+static double max_error(const std::vector<float>& mel, int n_len, const std::vector<float>& ref, int ref_len, int n_mel) {
+    double error = 0.0;
+    for (int j = 0; j < n_mel; j++) {
+        for (int i = 0; i < n_len; i++) {
+            error = std::max(error, (double)std::fabs(mel[(size_t)j * n_len + i] - ref[(size_t)j * ref_len + i]));
+        }
+    }
+    return error;
+}
+
+static std::vector<float> test_signal(size_t n) {
+    std::mt19937 rng(1);
+    std::normal_distribution<float> noise(0.0f, 0.1f);
+
+    std::vector<float> pcm(n);
+    for (size_t i = 0; i < n; i++) {
+        pcm[i] = 0.3f * std::sin(0.05f * i) + noise(rng);
+    }
+    return pcm;
+}
+
+// One frame: the FFT path against the DFT
+static void test_frame() {
+    MelStream stream(80);
+    const std::vector<float> frame = test_signal(MelStream::N_FFT);
+
+    std::vector<float> out(80);
+    stream.compute_frame(frame.data(), out.data());
+
+    const std::vector<double> power = dft_power(frame.data());
+    for (int j = 0; j < 80; j++) {
+        CHECK_NEAR(out[j], log_mel(stream.filters(), power, j), 1e-4);
+    }
+}
+
+// A whole utterance pushed in uneven blocks, ending before the last push
+static void test_utterance(int n_mel) {
+    MelStream stream(n_mel);
+    const std::vector<float> pcm = test_signal(2 * MelStream::SAMPLE_RATE + 77);
+    const size_t n_total = 25000;
+
+    for (size_t i = 0; i < pcm.size(); i += 333) {
+        stream.push(pcm.data() + i, std::min<size_t>(333, pcm.size() - i));
+    }
+
+    std::vector<float> mel;
+    const int n_len = stream.finish(n_total, 3000, mel);
+
+    int ref_len = 0;
+    const std::vector<float> ref =
+        reference_mel(std::vector<float>(pcm.begin(), pcm.begin() + n_total), stream.filters(), n_mel, ref_len);
+
+    CHECK(n_len >= 3000);
+    CHECK(n_len <= ref_len);
+    CHECK(max_error(mel, n_len, ref, ref_len, n_mel) < 1e-4);
+}
+
+// Shorter than one frame: only padding and the reflected start
+static void test_short() {
+    MelStream stream(80);
+    const std::vector<float> pcm = test_signal(150);
+    stream.push(pcm.data(), pcm.size());
+
+    std::vector<float> mel;
+    const int n_len = stream.finish(pcm.size(), 100, mel);
+
+    int ref_len = 0;
+    const std::vector<float> ref = reference_mel(pcm, stream.filters(), 80, ref_len);
+
+    CHECK(n_len >= 100);
+    CHECK(max_error(mel, n_len, ref, ref_len, 80) < 1e-4);
+}
+
+int main() {
+    test_frame();
+    test_utterance(80);
+    test_utterance(128);
+    test_short();
+
+    return test_result("test_mel_stream");
+}
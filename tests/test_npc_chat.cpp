@@ -0,0 +1,131 @@
+// Checks the request bodies NPCChat builds from its history. No request
+// is sent.
+
+#include "npc_chat.h"
+#include "npc_config.h"
+#include "test_util.h"
+
+#include <string>
+
+static std::string request(NPCChat& chat, const std::string& playerMessage) {
+    std::string body;
+    chat.buildRequest(playerMessage, body);
+    return body;
+}
+
+static void commit_turns(NPCChat& chat, int first, int last) {
+    for (int i = first; i <= last; i++) {
+        const std::string n = std::to_string(i);
+        chat.commitTurn("question " + n + " \"quoted\"\n", "answer " + n + " \\ \xc3\xa9");
+    }
+}
+
+// Trimming cuts the oldest turns out of the serialized history: the
+// request must be the one a chat holding only the kept turns builds
+static void test_trim(bool promptCaching) {
+    NPCHistoryPolicy policy;
+    policy.maxTurns = 3;
+
+    NPCChat chat("key");
+    chat.setPromptCaching(promptCaching);
+    chat.setHistoryPolicy(policy);
+    commit_turns(chat, 1, 10);
+
+    NPCChat expected("key");
+    expected.setPromptCaching(promptCaching);
+    expected.setHistoryPolicy(policy);
+    commit_turns(expected, 8, 10);
+    CHECK(request(chat, "next") == request(expected, "next"));
+
+    // The prompt in front of the history is replaced, the history kept
+    chat.setPersonality("A grumpy blacksmith.");
+    expected.setPersonality("A grumpy blacksmith.");
+    commit_turns(chat, 11, 11);
+    commit_turns(expected, 11, 11);
+    CHECK(request(chat, "next") == request(expected, "next"));
+
+    chat.setPromptCaching(!promptCaching);
+    NPCChat toggled("key");
+    toggled.setPersonality("A grumpy blacksmith.");
+    toggled.setPromptCaching(!promptCaching);
+    commit_turns(toggled, 9, 11);
+    CHECK(request(chat, "next") == request(toggled, "next"));
+
+    chat.clearHistory();
+    NPCChat cleared("key");
+    cleared.setPersonality("A grumpy blacksmith.");
+    cleared.setPromptCaching(!promptCaching);
+    CHECK(request(chat, "next") == request(cleared, "next"));
+}
+
+// Without a policy nothing is dropped
+static void test_unbounded() {
+    NPCChat chat("key");
+    commit_turns(chat, 1, 50);
+    const std::string body = request(chat, "next");
+    CHECK(body.find("question 1 ") != std::string::npos);
+    CHECK(body.find("answer 50 ") != std::string::npos);
+}
+
+// The cacheable prefix: everything up to the end of the cache_control
+// block, empty if there is none
+static std::string cached_prefix(const std::string& body) {
+    static const std::string marker = "\"cache_control\":{\"type\":\"ephemeral\"}}]}";
+    const size_t pos = body.find(marker);
+    return pos == std::string::npos ? "" : body.substr(0, pos + marker.size());
+}
+
+// With prompt caching the static prompt is the marked block, and neither a
+// new situation nor a new turn changes a byte up to it. The situation is
+// sent after the history.
+static void test_prompt_caching() {
+    NPCConfig config;
+    config.worldName = "Eldoria";
+    config.name = "Gareth";
+    config.role = "guard";
+    config.currentTime = "dawn";
+    config.currentMood = "tired";
+
+    NPCChat chat("key", config);
+    chat.setPromptCaching(true);
+
+    const std::string first = request(chat, "hello");
+    const std::string prefix = cached_prefix(first);
+    CHECK(!prefix.empty());
+    CHECK(prefix.find("Eldoria") != std::string::npos);
+    CHECK(prefix.find("Time: dawn") == std::string::npos);
+
+    chat.setSituation("=== RIGHT NOW ===\nTime: dusk\nMood: alert\n");
+    const std::string situated = request(chat, "hello");
+    CHECK(cached_prefix(situated) == prefix);
+    CHECK(situated.find("Time: dusk") != std::string::npos);
+    CHECK(situated.find("Time: dawn") == std::string::npos);
+
+    chat.commitTurn("Who goes there?", "Only a traveller.");
+    chat.commitTurn("Open the gate.", "Not before noon.");
+    const std::string later = request(chat, "Please?");
+    CHECK(cached_prefix(later) == prefix);
+
+    const size_t history = later.find("Not before noon.");
+    const size_t situation = later.find("Time: dusk");
+    const size_t player = later.find("Please?");
+    CHECK(later.find("Who goes there?") < history);
+    CHECK(history != std::string::npos && situation != std::string::npos && player != std::string::npos);
+    CHECK(history < situation);
+    CHECK(situation < player);
+
+    // The request before the situation is the one before, extended
+    chat.setSituation("");
+    const std::string plain = request(chat, "Please?");
+    CHECK(plain.find("RIGHT NOW") == std::string::npos);
+    CHECK(plain.compare(0, history, later, 0, history) == 0);
+}
+
+int main() {
+    test_trim(false);
+    test_trim(true);
+    test_unbounded();
+    test_prompt_caching();
+
+    return test_result("test_npc_chat");
+}
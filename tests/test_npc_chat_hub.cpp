@@ -0,0 +1,170 @@
+// Many NPC sessions over one NPCChatHub, against a local mock of the chat
+// completions API: replies reach the right session in order, each request
+// carries the session's own history, and summaries go through the hub.
+
+#include "mock_server.h"
+#include "npc_chat_hub.h"
+#include "test_util.h"
+
+#include <chrono>
+#include <string>
+#include <thread>
+
+static const int N_SESSIONS = 6;
+static const int N_LINES = 4;
+
+// The player line a request asks about
+static std::string player_line(const std::string& body) {
+    static const std::string marker = "{\"role\":\"user\",\"content\":\"";
+    const size_t start = body.rfind(marker);
+    if (start == std::string::npos) {
+        return "";
+    }
+    const size_t begin = start + marker.size();
+    return body.substr(begin, body.find('"', begin) - begin);
+}
+
+static std::string line_name(int session, int line) {
+    return "s" + std::to_string(session) + " l" + std::to_string(line);
+}
+
+// Answers "re: <line>", after checking the request has the session's
+// previous exchange and no other session's
+static MockResponse answer(int index, const std::string& body) {
+    MockResponse response;
+    response.delayMs = (index * 7) % 30;
+
+    if (body.find("You maintain the memory") != std::string::npos) {
+        response.body = MockServer::completion("The player asked about the gate.");
+        return response;
+    }
+
+    const std::string line = player_line(body);
+    const int session = line.size() > 1 ? line[1] - '0' : -1;
+    const int number = line.size() > 4 ? line[4] - '0' : -1;
+    bool consistent = session >= 0 && number >= 0;
+    if (consistent && number > 0) {
+        consistent = body.find("re: " + line_name(session, number - 1)) != std::string::npos;
+    }
+    for (int other = 0; other < N_SESSIONS && consistent; other++) {
+        consistent = other == session || body.find("\"s" + std::to_string(other) + " l") == std::string::npos;
+    }
+
+    response.body = MockServer::completion(consistent ? "re: " + line : "inconsistent");
+    return response;
+}
+
+static NPCConfig npc(int i) {
+    NPCConfig config;
+    config.name = "NPC " + std::to_string(i);
+    config.role = "villager";
+    return config;
+}
+
+static void test_sessions() {
+    MockServer server(answer);
+    NPCChatHub hub("key", server.url(), "", 4);
+
+    std::vector<NPCChatHub::SessionId> ids;
+    for (int i = 0; i < N_SESSIONS; i++) {
+        ids.push_back(hub.addSession(npc(i)));
+    }
+
+    // All lines at once, from several threads: later lines of a session
+    // wait for the reply before them
+    std::vector<std::thread> senders;
+    for (int i = 0; i < N_SESSIONS; i++) {
+        senders.emplace_back([&hub, &ids, i] {
+            for (int line = 0; line < N_LINES; line++) {
+                hub.send(ids[i], line_name(i, line));
+            }
+        });
+    }
+    for (std::thread& sender : senders) {
+        sender.join();
+    }
+
+    for (int i = 0; i < N_SESSIONS; i++) {
+        for (int line = 0; line < N_LINES; line++) {
+            NPCReply reply;
+            CHECK(hub.wait(ids[i], reply, 5000));
+            CHECK(reply.ok);
+            CHECK(reply.text == "re: " + line_name(i, line));
+        }
+        NPCReply extra;
+        CHECK(!hub.poll(ids[i], extra));
+    }
+    CHECK(server.requests() == N_SESSIONS * N_LINES);
+
+    // A request stops counting just after its reply is delivered
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+    while (hub.pending() > 0 && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    CHECK(hub.pending() == 0);
+
+    std::string body;
+    hub.session(ids[2]).buildRequest("next", body);
+    CHECK(body.find("re: " + line_name(2, N_LINES - 1)) != std::string::npos);
+}
+
+// Turns dropped from a session's history are summarized over the hub
+static void test_summary() {
+    MockServer server(answer);
+    NPCChatHub hub("key", server.url());
+    const NPCChatHub::SessionId id = hub.addSession(npc(0));
+
+    NPCHistoryPolicy policy;
+    policy.maxTurns = 1;
+    policy.summarize = true;
+    hub.session(id).setHistoryPolicy(policy);
+
+    for (int line = 0; line < 3; line++) {
+        hub.send(id, line_name(0, line));
+        NPCReply reply;
+        CHECK(hub.wait(id, reply, 5000));
+        CHECK(reply.ok);
+    }
+
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (hub.session(id).getMemory().empty() && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    CHECK(hub.session(id).getMemory() == "The player asked about the gate.");
+    CHECK(server.requests() > 3);
+}
+
+// A failed request gives the fallback line, and the next one still goes out
+static void test_failure() {
+    MockServer server([](int index, const std::string& body) {
+        MockResponse response;
+        if (index == 0) {
+            response.status = 500;
+            response.body = "{\"error\":{\"message\":\"mock\"}}";
+        } else {
+            response.body = MockServer::completion("re: " + player_line(body));
+        }
+        return response;
+    });
+    NPCChatHub hub("key", server.url());
+    const NPCChatHub::SessionId id = hub.addSession(npc(0));
+
+    hub.send(id, "first");
+    hub.send(id, "second");
+
+    NPCReply reply;
+    CHECK(hub.wait(id, reply, 5000));
+    CHECK(!reply.ok);
+    CHECK(reply.text == FALLBACK_REPLY);
+    CHECK(hub.wait(id, reply, 5000));
+    CHECK(reply.ok);
+    CHECK(reply.text == "re: second");
+}
+
+int main() {
+    test_sessions();
+    test_summary();
+    test_failure();
+
+    return test_result("test_npc_chat_hub");
+}
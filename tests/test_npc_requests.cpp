@@ -0,0 +1,184 @@
+// Retries, hedging and deadlines of NPCChat requests, against a local
+// mock of the chat completions API.
+
+#include "mock_server.h"
+#include "npc_chat.h"
+#include "test_util.h"
+
+#include <chrono>
+#include <string>
+
+static NPCRequestPolicy fast_policy() {
+    NPCRequestPolicy policy;
+    policy.backoffMs = 10;
+    policy.deadlineMs = 3000;
+    return policy;
+}
+
+static MockResponse error(int status) {
+    MockResponse response;
+    response.status = status;
+    response.body = "{\"error\":{\"message\":\"mock\",\"code\":" + std::to_string(status) + "}}";
+    return response;
+}
+
+static MockResponse reply(const std::string& content, long delayMs = 0) {
+    MockResponse response;
+    response.body = MockServer::completion(content);
+    response.delayMs = delayMs;
+    return response;
+}
+
+static MockResponse stream(const std::vector<std::string>& tokens, bool drop = false) {
+    MockResponse response;
+    for (const std::string& token : tokens) {
+        response.events.push_back(MockServer::delta(token));
+    }
+    if (!drop) {
+        response.events.push_back("[DONE]");
+    }
+    response.eventDelayMs = 20;
+    response.drop = drop;
+    return response;
+}
+
+static MockResponse hang() {
+    MockResponse response = reply("too late");
+    response.delayMs = 10000;
+    return response;
+}
+
+// Server errors are retried until one gets through
+static void test_retry() {
+    MockServer server([](int index, const std::string&) { return index < 2 ? error(index == 0 ? 503 : 429) : reply("Halt!"); });
+    NPCChat chat("key");
+    chat.setEndpoint(server.url());
+    chat.setRequestPolicy(fast_policy());
+
+    const NPCReply result = chat.chatAsync("Hello").get();
+    CHECK(result.ok);
+    CHECK(result.text == "Halt!");
+    CHECK(result.attempts == 3);
+    CHECK(!result.hedged);
+    CHECK(server.requests() == 3);
+
+    // The turn is in the history
+    std::string body;
+    chat.buildRequest("next", body);
+    CHECK(body.find("Halt!") != std::string::npos);
+}
+
+// Client errors are not retried, and attempts are limited
+static void test_give_up() {
+    MockServer unauthorized([](int, const std::string&) { return error(401); });
+    NPCChat chat("key");
+    chat.setEndpoint(unauthorized.url());
+    chat.setRequestPolicy(fast_policy());
+
+    NPCReply result = chat.chatAsync("Hello").get();
+    CHECK(!result.ok);
+    CHECK(result.text == FALLBACK_REPLY);
+    CHECK(result.attempts == 1);
+    CHECK(unauthorized.requests() == 1);
+
+    MockServer failing([](int, const std::string&) { return error(500); });
+    NPCRequestPolicy policy = fast_policy();
+    policy.maxAttempts = 2;
+    chat.setEndpoint(failing.url());
+    chat.setRequestPolicy(policy);
+
+    result = chat.chatAsync("Hello").get();
+    CHECK(!result.ok);
+    CHECK(result.attempts == 2);
+    CHECK(failing.requests() == 2);
+}
+
+// A reply slower than the p95 of earlier ones is raced by a second request
+static void test_hedge() {
+    MockServer server([](int index, const std::string&) {
+        return index == 0 ? reply("warm", 50) : index == 1 ? hang() : reply("Hedged.");
+    });
+    NPCChat chat("key");
+    chat.setEndpoint(server.url());
+    NPCRequestPolicy policy = fast_policy();
+    policy.hedge = true;
+    policy.hedgeMinSamples = 1;
+    chat.setRequestPolicy(policy);
+
+    NPCReply result = chat.chatAsync("Hello").get();
+    CHECK(result.ok);
+    CHECK(!result.hedged);
+    CHECK(chat.latencyP95Ms() >= 50);
+
+    result = chat.chatAsync("Again").get();
+    CHECK(result.ok);
+    CHECK(result.text == "Hedged.");
+    CHECK(result.hedged);
+    CHECK(result.attempts == 2);
+    CHECK(result.latencyMs < 2000);
+}
+
+// The deadline covers the whole call, however slow the server is
+static void test_deadline() {
+    MockServer server([](int, const std::string&) { return hang(); });
+    NPCChat chat("key");
+    chat.setEndpoint(server.url());
+    NPCRequestPolicy policy = fast_policy();
+    policy.deadlineMs = 300;
+    chat.setRequestPolicy(policy);
+
+    const NPCReply result = chat.chatAsync("Hello").get();
+    CHECK(!result.ok);
+    CHECK(result.text == FALLBACK_REPLY);
+    CHECK(result.latencyMs < 2000);
+
+    const auto start = std::chrono::steady_clock::now();
+    std::string response;
+    CHECK(!chat.completeStream("Hello", nullptr, response));
+    CHECK(std::chrono::steady_clock::now() - start < std::chrono::seconds(2));
+}
+
+// A stream that fails before its first token is retried
+static void test_stream_retry() {
+    MockServer server([](int index, const std::string&) { return index == 0 ? error(503) : stream({"Who ", "goes ", "there?"}); });
+    NPCChat chat("key");
+    chat.setEndpoint(server.url());
+    chat.setRequestPolicy(fast_policy());
+
+    std::string tokens;
+    const std::string response = chat.chatStream("Hello", [&](const std::string& token) {
+        tokens += token;
+        return true;
+    });
+    CHECK(response == "Who goes there?");
+    CHECK(tokens == response);
+    CHECK(server.requests() == 2);
+}
+
+// One that fails after a token is not: the caller has used the token
+static void test_stream_drop() {
+    MockServer server([](int, const std::string&) { return stream({"Who ", "goes "}, true); });
+    NPCChat chat("key");
+    chat.setEndpoint(server.url());
+    chat.setRequestPolicy(fast_policy());
+
+    int calls = 0;
+    const std::string response = chat.chatStream("Hello", [&](const std::string&) {
+        calls++;
+        return true;
+    });
+    CHECK(response == FALLBACK_REPLY);
+    CHECK(calls == 2);
+    CHECK(server.requests() == 1);
+}
+
+int main() {
+    test_retry();
+    test_give_up();
+    test_hedge();
+    test_deadline();
+    test_stream_retry();
+    test_stream_drop();
+
+    return test_result("test_npc_requests");
+}
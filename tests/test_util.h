@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cmath>
+#include <cstdio>
+
+// Minimal checks for the test programs. A failed check is reported with
+// its location and counted; main() returns test_result() so ctest sees it.
+
+inline int& test_failures() {
+    static int failures = 0;
+    return failures;
+}
+
+#define CHECK(cond)                                                               \
+    do {                                                                          \
+        if (!(cond)) {                                                            \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            test_failures()++;                                                    \
+        }                                                                         \
+    } while (0)
+
+#define CHECK_NEAR(a, b, tol)                                                              \
+    do {                                                                                   \
+        const double check_a = (a), check_b = (b);                                         \
+        if (!(std::fabs(check_a - check_b) <= (tol))) {                                    \
+            fprintf(stderr, "%s:%d: check failed: %s = %g, %s = %g (tolerance %g)\n",      \
+                    __FILE__, __LINE__, #a, check_a, #b, check_b, (double)(tol));          \
+            test_failures()++;                                                             \
+        }                                                                                  \
+    } while (0)
+
+inline int test_result(const char* name) {
+    if (test_failures() > 0) {
+        fprintf(stderr, "%s: %d check(s) failed\n", name, test_failures());
+        return 1;
+    }
+    fprintf(stderr, "%s: all checks passed\n", name);
+    return 0;
+}
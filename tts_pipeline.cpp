@@ -0,0 +1,128 @@
+#include "tts_pipeline.h"
+
+#include <cstdio>
+
+TtsPipeline::TtsPipeline(piper_synthesizer* synth, const piper_synthesize_options& options, AudioSink* sink)
+    : m_synth(synth), m_options(options), m_sink(sink) {
+    m_thread = std::thread(&TtsPipeline::run, this);
+}
+
+TtsPipeline::~TtsPipeline() {
+    stop();
+}
+
+void TtsPipeline::say(const std::string& sentence) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_queue.push_back(sentence);
+    }
+    m_cv.notify_all();
+}
+
+void TtsPipeline::finish() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_endOfReply = true;
+    m_cv.notify_all();
+    m_cv.wait(lock, [this] { return (m_queue.empty() && !m_busy && !m_endOfReply) || m_stop; });
+}
+
+void TtsPipeline::clear() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_queue.clear();
+}
+
+void TtsPipeline::abort() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_queue.clear();
+    m_generation++;
+    m_abort = true;
+    m_cv.notify_all();
+
+    // Until the thread is idle with the stream closed
+    m_cv.wait(lock, [this] { return !m_abort || m_stop; });
+}
+
+void TtsPipeline::stop() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_cv.notify_all();
+
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+}
+
+void TtsPipeline::run() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    while (true) {
+        m_cv.wait(lock, [this] { return !m_queue.empty() || m_endOfReply || m_abort || m_stop; });
+        if (m_stop) {
+            break;
+        }
+
+        const unsigned generation = m_generation;
+
+        if (m_abort) {
+            // What piper still has queued is dropped by the next
+            // piper_synthesize_start()
+            lock.unlock();
+            if (m_streamOpen) {
+                piper_synthesize_finish(m_synth);
+                m_streamOpen = false;
+            }
+            lock.lock();
+            m_abort = false;
+            m_endOfReply = false;
+            m_cv.notify_all();
+            continue;
+        }
+
+        if (m_queue.empty()) {
+            // End of the reply: close the stream and play what is left
+            lock.unlock();
+            if (m_streamOpen) {
+                piper_synthesize_finish(m_synth);
+                drain(generation);
+                m_streamOpen = false;
+            }
+            lock.lock();
+            m_endOfReply = false;
+            m_cv.notify_all();
+            continue;
+        }
+
+        const std::string sentence = std::move(m_queue.front());
+        m_queue.pop_front();
+        m_busy = true;
+        lock.unlock();
+
+        if (!m_streamOpen) {
+            m_streamOpen = piper_synthesize_start(m_synth, "", &m_options) == PIPER_OK;
+        }
+
+        // The line break tells piper the sentence is complete
+        if (m_streamOpen && piper_synthesize_append(m_synth, (sentence + "\n").c_str()) == PIPER_OK) {
+            drain(generation);
+        } else {
+            fprintf(stderr, "%s: synthesis failed for '%s'\n", __func__, sentence.c_str());
+        }
+
+        lock.lock();
+        m_busy = false;
+        m_cv.notify_all();
+    }
+}
+
+void TtsPipeline::drain(unsigned generation) {
+    piper_audio_chunk chunk;
+    while (piper_synthesize_next(m_synth, &chunk) == PIPER_OK) {
+        // Checked per chunk, so abort() cuts a sentence short
+        if (m_generation != generation) {
+            return;
+        }
+        m_sink->queue(chunk.samples, chunk.num_samples);
+    }
+}
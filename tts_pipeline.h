@@ -0,0 +1,69 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "piper.h"
+#include "audio_sink.h"
+
+// Synthesizes queued sentences on its own thread and sends the audio to a
+// sink, so the caller can keep receiving the LLM reply while the first
+// sentence is already being spoken.
+//
+// The sentences of one reply are appended to a single piper stream
+// (piper_synthesize_append) that finish() closes, so piper is set up once
+// per reply rather than once per sentence.
+//
+// The synthesizer belongs to the pipeline thread while it runs; don't use
+// it from elsewhere until stop().
+class TtsPipeline {
+public:
+    TtsPipeline(piper_synthesizer* synth, const piper_synthesize_options& options, AudioSink* sink);
+    ~TtsPipeline();
+
+    // Queue a sentence for synthesis
+    void say(const std::string& sentence);
+
+    // End of the reply: wait until everything queued has been synthesized
+    // and handed to the sink (it may still be playing)
+    void finish();
+
+    // Drop queued sentences (the one being synthesized still completes)
+    void clear();
+
+    // Drop queued sentences and stop the one being synthesized: no more of
+    // its audio reaches the sink once this returns, so the sink can be
+    // cleared after it. Closes the reply's piper stream.
+    void abort();
+
+    // Stop the thread
+    void stop();
+
+private:
+    void run();
+
+    // Hand audio to the sink until piper wants more text or is done, or
+    // until abort() moves on from generation
+    void drain(unsigned generation);
+
+    piper_synthesizer* m_synth;
+    piper_synthesize_options m_options;
+    AudioSink* m_sink;
+
+    std::thread m_thread;
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::deque<std::string> m_queue;
+    bool m_busy = false;
+    bool m_endOfReply = false;
+    bool m_stop = false;
+    bool m_abort = false;
+    std::atomic<unsigned> m_generation{0};  // bumped by abort()
+
+    // Only touched by the pipeline thread
+    bool m_streamOpen = false;
+};
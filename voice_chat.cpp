@@ -6,13 +6,32 @@
 #include <thread>
 #include <chrono>
 #include <fstream>
+#include <filesystem>
+#include <memory>
+#include <algorithm>
+#include <future>
+#include <cctype>
+#include <atomic>
 
 #include "whisper.h"
 #include "ggml-backend.h"
 #include "piper.h"
 #include "npc_chat.h"
+#include "resource_manager.h"
+#include "sentence_assembler.h"
+#include "tts_pipeline.h"
 #include "audio_capture.h"
+#include "audio_source.h"
 #include "audio_playback.h"
+#include "endpointer.h"
+#include "keyword_spotter.h"
+#include "stt_stream.h"
+#include "mel_stream.h"
+#include "stt_params.h"
+#include "stt_worker.h"
+#include "stt_calibrate.h"
+#include "stt_metrics.h"
+#include "wav_file.h"
 
 struct voice_chat_params {
     std::string whisper_model = "";
@@ -21,13 +40,47 @@ struct voice_chat_params {
     std::string espeak_data = "";
 
     int capture_id = -1;
-    int n_threads = 4;
+    std::string input_file = "";  // replay a WAV file instead of the microphone
+    float input_speed = 1.0f;
+    std::string output_file = "";  // write NPC speech to a WAV file instead of the speakers
+    bool null_output = false;      // discard NPC speech (timing only)
+    int n_threads = 4;    // per whisper run
+    bool n_threads_set = false;
+    int stt_workers = 1;  // concurrent whisper runs (one state each)
 
-    float vad_thold = 0.6f;
     float freq_thold = 100.0f;
+    int vad_hangover_ms = 400;        // silence required before end of utterance
+    int vad_short_hangover_ms = 200;  // ... when the transcript ends a sentence
+    int vad_margin_ms = 200;          // audio kept around the detected speech
+    bool fit_audio_ctx = true;        // shrink the whisper encoder to the utterance
+    bool incremental_mel = true;      // compute the spectrogram while the player speaks
+
+    bool calibrate = false;           // benchmark models and thread counts, then exit
+    float target_rtf = 0.25f;         // slowest acceptable whisper real-time factor
+    std::string calibration_file = "stt_calibration.txt";
 
     int step_ms = 3000;
     int length_ms = 10000;
+    bool stream = false;  // transcribe while the player is still speaking
+
+    bool kws = false;                 // handle control phrases without whisper / the LLM
+    std::string kws_commands = "";    // command list (default: goodbye, repeat that, stop)
+    float kws_threshold = 2.0f;       // DTW distance for a keyword match
+
+    std::string stt_cores = "";       // CPU partitioning (see resource_manager.h)
+    std::string tts_cores = "";
+    bool pin_threads = false;
+
+    std::string llm_url = "";         // chat completions endpoint (default: OpenRouter)
+    std::string ca_bundle = "";       // CA certificates for llm_url
+
+    int history_turns = 0;            // exchanges sent with each request (0: all)
+    int history_tokens = 0;           // estimated token budget of those (0: no limit)
+    bool summarize_history = false;   // fold dropped exchanges into a memory
+    bool prompt_cache = false;        // cache_control on the static system prompt
+
+    bool speculate = false;             // ask the LLM on a confident partial transcript
+    float speculate_similarity = 0.8f;  // final vs partial word similarity to keep the reply
 };
 
 void print_usage(const char* prog) {
@@ -39,7 +92,36 @@ void print_usage(const char* prog) {
     fprintf(stderr, "  -pc, --piper-config <path>   Path to piper config (.onnx.json)\n");
     fprintf(stderr, "  -ed, --espeak-data <path>    Path to espeak-ng data directory\n");
     fprintf(stderr, "  -c,  --capture <id>          Capture device ID (default: -1 for default)\n");
+    fprintf(stderr, "  -if, --input-file <path>     Replay a WAV file instead of the microphone\n");
+    fprintf(stderr, "  -is, --input-speed <x>       Input file replay speed (default: 1.0 = real time)\n");
+    fprintf(stderr, "  -of, --output-file <path>    Write NPC speech to a WAV file instead of the speakers\n");
+    fprintf(stderr, "  -no, --null-output           Discard NPC speech (playback timing is still simulated)\n");
     fprintf(stderr, "  -t,  --threads <n>           Number of threads (default: 4)\n");
+    fprintf(stderr, "       --stt-workers <n>       Concurrent transcriptions sharing one model (default: 1)\n");
+    fprintf(stderr, "       --stt-cores <list>      Cores for whisper, e.g. 0-5 (caps threads x workers)\n");
+    fprintf(stderr, "       --tts-cores <list>      Cores for piper / ONNX Runtime, e.g. 6,7\n");
+    fprintf(stderr, "       --pin                   Pin STT and TTS threads to their cores\n");
+    fprintf(stderr, "  -st, --stream                Transcribe while the player is speaking\n");
+    fprintf(stderr, "       --step <ms>             Streaming decode interval (default: 3000)\n");
+    fprintf(stderr, "  -l,  --length <ms>           Audio buffer / streaming window length (default: 10000)\n");
+    fprintf(stderr, "       --speculate             Send the LLM request on a confident partial transcript (needs -st)\n");
+    fprintf(stderr, "       --speculate-similarity <x> Final/partial word similarity to keep the reply (default: 0.8)\n");
+    fprintf(stderr, "  -vh, --vad-hangover <ms>     Silence before end of utterance (default: 400)\n");
+    fprintf(stderr, "  -vm, --vad-margin <ms>       Audio kept around detected speech (default: 200)\n");
+    fprintf(stderr, "  -nac, --no-audio-ctx         Always run the encoder over the full 30 s context\n");
+    fprintf(stderr, "  -nim, --no-incremental-mel   Let whisper compute the spectrogram at end of speech\n");
+    fprintf(stderr, "  -kw, --keywords              Spot control phrases (goodbye, repeat that, stop) before whisper\n");
+    fprintf(stderr, "       --keywords-file <path>  Command list: one \"<quit|repeat|reset> <phrase or .wav>\" per line\n");
+    fprintf(stderr, "       --keywords-threshold <x> Keyword match distance (default: 2.0)\n");
+    fprintf(stderr, "       --calibrate             Pick the whisper model and threads for this CPU, then exit\n");
+    fprintf(stderr, "       --target-rtf <x>        Slowest acceptable real-time factor (default: 0.25)\n");
+    fprintf(stderr, "       --calibration-file <path> Calibration results (default: stt_calibration.txt)\n");
+    fprintf(stderr, "       --llm-url <url>         Chat completions endpoint (default: OpenRouter)\n");
+    fprintf(stderr, "       --ca-bundle <path>      CA certificates for the endpoint (e.g. a local test server)\n");
+    fprintf(stderr, "       --history-turns <n>     Exchanges sent to the LLM, older ones are dropped (default: all)\n");
+    fprintf(stderr, "       --history-tokens <n>    Estimated token budget for those exchanges (default: no limit)\n");
+    fprintf(stderr, "       --summarize-history     Summarize dropped exchanges into a memory in the background\n");
+    fprintf(stderr, "       --prompt-cache          Mark the static system prompt for provider-side caching\n");
     fprintf(stderr, "  -h,  --help                  Show this help\n");
     fprintf(stderr, "\n");
     fprintf(stderr, "Environment:\n");
@@ -69,8 +151,97 @@ bool parse_args(int argc, char** argv, voice_chat_params& params) {
         else if ((arg == "-c" || arg == "--capture") && i + 1 < argc) {
             params.capture_id = std::stoi(argv[++i]);
         }
+        else if ((arg == "-if" || arg == "--input-file") && i + 1 < argc) {
+            params.input_file = argv[++i];
+        }
+        else if ((arg == "-is" || arg == "--input-speed") && i + 1 < argc) {
+            params.input_speed = std::stof(argv[++i]);
+        }
+        else if ((arg == "-of" || arg == "--output-file") && i + 1 < argc) {
+            params.output_file = argv[++i];
+        }
+        else if (arg == "-no" || arg == "--null-output") {
+            params.null_output = true;
+        }
         else if ((arg == "-t" || arg == "--threads") && i + 1 < argc) {
             params.n_threads = std::stoi(argv[++i]);
+            params.n_threads_set = true;
+        }
+        else if (arg == "--stt-workers" && i + 1 < argc) {
+            params.stt_workers = std::stoi(argv[++i]);
+        }
+        else if (arg == "--stt-cores" && i + 1 < argc) {
+            params.stt_cores = argv[++i];
+        }
+        else if (arg == "--tts-cores" && i + 1 < argc) {
+            params.tts_cores = argv[++i];
+        }
+        else if (arg == "--pin") {
+            params.pin_threads = true;
+        }
+        else if (arg == "-st" || arg == "--stream") {
+            params.stream = true;
+        }
+        else if (arg == "--step" && i + 1 < argc) {
+            params.step_ms = std::stoi(argv[++i]);
+        }
+        else if ((arg == "-l" || arg == "--length") && i + 1 < argc) {
+            params.length_ms = std::stoi(argv[++i]);
+        }
+        else if (arg == "--llm-url" && i + 1 < argc) {
+            params.llm_url = argv[++i];
+        }
+        else if (arg == "--ca-bundle" && i + 1 < argc) {
+            params.ca_bundle = argv[++i];
+        }
+        else if (arg == "--history-turns" && i + 1 < argc) {
+            params.history_turns = std::stoi(argv[++i]);
+        }
+        else if (arg == "--history-tokens" && i + 1 < argc) {
+            params.history_tokens = std::stoi(argv[++i]);
+        }
+        else if (arg == "--summarize-history") {
+            params.summarize_history = true;
+        }
+        else if (arg == "--prompt-cache") {
+            params.prompt_cache = true;
+        }
+        else if (arg == "--speculate") {
+            params.speculate = true;
+        }
+        else if (arg == "--speculate-similarity" && i + 1 < argc) {
+            params.speculate_similarity = std::stof(argv[++i]);
+        }
+        else if ((arg == "-vh" || arg == "--vad-hangover") && i + 1 < argc) {
+            params.vad_hangover_ms = std::stoi(argv[++i]);
+        }
+        else if ((arg == "-vm" || arg == "--vad-margin") && i + 1 < argc) {
+            params.vad_margin_ms = std::stoi(argv[++i]);
+        }
+        else if (arg == "-nac" || arg == "--no-audio-ctx") {
+            params.fit_audio_ctx = false;
+        }
+        else if (arg == "-nim" || arg == "--no-incremental-mel") {
+            params.incremental_mel = false;
+        }
+        else if (arg == "-kw" || arg == "--keywords") {
+            params.kws = true;
+        }
+        else if (arg == "--keywords-file" && i + 1 < argc) {
+            params.kws_commands = argv[++i];
+            params.kws = true;
+        }
+        else if (arg == "--keywords-threshold" && i + 1 < argc) {
+            params.kws_threshold = std::stof(argv[++i]);
+        }
+        else if (arg == "--calibrate") {
+            params.calibrate = true;
+        }
+        else if (arg == "--target-rtf" && i + 1 < argc) {
+            params.target_rtf = std::stof(argv[++i]);
+        }
+        else if (arg == "--calibration-file" && i + 1 < argc) {
+            params.calibration_file = argv[++i];
         }
         else {
             fprintf(stderr, "Unknown argument: %s\n", arg.c_str());
@@ -79,8 +250,13 @@ bool parse_args(int argc, char** argv, voice_chat_params& params) {
         }
     }
 
-    if (params.whisper_model.empty()) {
-        fprintf(stderr, "Error: Whisper model path required (-wm)\n");
+    // Without -wm the calibrated model is used (see main)
+    if (params.whisper_model.empty() && params.calibrate) {
+        fprintf(stderr, "Error: --calibrate needs -wm to find the model directory\n");
+        return false;
+    }
+    if (params.speculate && !params.stream) {
+        fprintf(stderr, "Error: --speculate needs streaming transcription (-st)\n");
         return false;
     }
     if (params.piper_model.empty()) {
@@ -162,6 +338,36 @@ std::string load_api_key() {
     return "";
 }
 
+// Whether text ends a sentence (used to shorten the endpoint hangover)
+static bool ends_sentence(const std::string& text) {
+    size_t end = text.size();
+    while (end > 0 && std::isspace((unsigned char)text[end - 1])) {
+        end--;
+    }
+    return end > 0 && (text[end - 1] == '.' || text[end - 1] == '?' || text[end - 1] == '!');
+}
+
+// An LLM reply requested on a partial transcript, before the player has
+// finished speaking
+struct SpeculativeReply {
+    std::string prompt;  // partial transcript the reply answers
+    std::string response;
+    std::atomic_bool cancel{false};
+    std::future<bool> done;
+};
+
+static std::unique_ptr<SpeculativeReply> start_speculation(NPCChat& npc, const std::string& prompt) {
+    std::unique_ptr<SpeculativeReply> spec(new SpeculativeReply());
+    spec->prompt = prompt;
+
+    SpeculativeReply* s = spec.get();
+    s->done = std::async(std::launch::async, [&npc, s]() {
+        return npc.complete(s->prompt, s->response, &s->cancel);
+    });
+
+    return spec;
+}
+
 // Trim whitespace and filter out whisper artifacts
 std::string clean_transcription(const std::string& text) {
     std::string result;
@@ -190,6 +396,147 @@ std::string clean_transcription(const std::string& text) {
     return result;
 }
 
+// Synthesize text with piper and resample it for whisper / the keyword spotter
+static bool synthesize_pcm(piper_synthesizer* synth, const char* text, std::vector<float>& pcm) {
+    std::vector<float> speech;
+    int speech_rate = 0;
+    piper_synthesize_options piper_opts = piper_default_synthesize_options(synth);
+    if (piper_synthesize_start(synth, text, &piper_opts) == PIPER_OK) {
+        piper_audio_chunk chunk;
+        while (piper_synthesize_next(synth, &chunk) == PIPER_OK) {
+            speech.insert(speech.end(), chunk.samples, chunk.samples + chunk.num_samples);
+            speech_rate = chunk.sample_rate;
+        }
+    }
+
+    if (speech.empty() || speech_rate <= 0) {
+        return false;
+    }
+
+    resample_linear(speech, speech_rate, pcm, WHISPER_SAMPLE_RATE);
+    return true;
+}
+
+// Control phrases handled locally, as "<action> <phrase or .wav>"
+static const char* DEFAULT_KEYWORD_COMMANDS[] = {
+    "quit goodbye",
+    "repeat repeat that",
+    "reset stop",
+};
+
+// Add a template per command line: recorded examples (.wav) of the player
+// work best, phrases are synthesized with the NPC voice
+static bool load_keyword_commands(const std::string& path, piper_synthesizer* synth, KeywordSpotter& spotter) {
+    std::vector<std::string> lines;
+    if (path.empty()) {
+        lines.assign(std::begin(DEFAULT_KEYWORD_COMMANDS), std::end(DEFAULT_KEYWORD_COMMANDS));
+    } else {
+        std::ifstream file(path);
+        if (!file.is_open()) {
+            fprintf(stderr, "Error: Cannot open keyword file %s\n", path.c_str());
+            return false;
+        }
+        std::string line;
+        while (std::getline(file, line)) {
+            while (!line.empty() && std::isspace((unsigned char)line.back())) line.pop_back();
+            if (line.empty() || line[0] == '#') continue;
+            lines.push_back(line);
+        }
+    }
+
+    for (const std::string& line : lines) {
+        const size_t sep = line.find(' ');
+        const std::string action = line.substr(0, sep);
+        const std::string phrase = sep != std::string::npos ? line.substr(line.find_first_not_of(' ', sep)) : "";
+
+        if (action != "quit" && action != "repeat" && action != "reset") {
+            fprintf(stderr, "Error: Unknown keyword action '%s' (quit, repeat or reset)\n", action.c_str());
+            return false;
+        }
+
+        std::vector<float> pcm;
+        bool ok = false;
+        if (phrase.size() > 4 && phrase.compare(phrase.size() - 4, 4, ".wav") == 0) {
+            std::vector<float> samples;
+            int sample_rate = 0;
+            ok = read_wav(phrase, samples, sample_rate);
+            if (ok) {
+                resample_linear(samples, sample_rate, pcm, WHISPER_SAMPLE_RATE);
+            }
+        } else if (!phrase.empty()) {
+            ok = synthesize_pcm(synth, phrase.c_str(), pcm);
+        }
+
+        if (!ok || !spotter.add_template(action, pcm.data(), pcm.size())) {
+            fprintf(stderr, "Error: No keyword template from '%s'\n", phrase.c_str());
+            return false;
+        }
+        fprintf(stderr, "Keyword: %s -> %s\n", phrase.c_str(), action.c_str());
+    }
+
+    return true;
+}
+
+// Something a player might say to the guard, long enough to show how the
+// encoder and decoder scale
+static const char* CALIBRATION_TEXT =
+    "Good evening, guard. I have traveled from the northern villages and need shelter for the night. "
+    "Could you tell me where the nearest inn is?";
+
+// Benchmark the whisper models next to -wm on a synthesized utterance and
+// store the best choice for this CPU
+static int run_calibration(const voice_chat_params& params) {
+    fprintf(stderr, "Loading piper model: %s\n", params.piper_model.c_str());
+    const char* piper_cfg = params.piper_config.empty() ? nullptr : params.piper_config.c_str();
+    piper_synthesizer* synth = piper_create(params.piper_model.c_str(), piper_cfg, params.espeak_data.c_str());
+    if (!synth) {
+        fprintf(stderr, "Error: Failed to create piper synthesizer\n");
+        return 1;
+    }
+
+    std::vector<float> pcm;
+    const bool synthesized = synthesize_pcm(synth, CALIBRATION_TEXT, pcm);
+    piper_free(synth);
+
+    if (!synthesized) {
+        fprintf(stderr, "Error: Failed to synthesize the calibration utterance\n");
+        return 1;
+    }
+
+    const std::string dir = std::filesystem::path(params.whisper_model).parent_path().string();
+    const std::vector<std::string> models = find_whisper_models(dir);
+    if (models.empty()) {
+        fprintf(stderr, "Error: No ggml-*.bin models in %s\n", dir.empty() ? "." : dir.c_str());
+        return 1;
+    }
+
+    const std::string cpu = cpu_signature();
+    fprintf(stderr, "Calibrating on %s: %zu models, %.1f s utterance, target RTF %.2f\n",
+            cpu.c_str(), models.size(), (float)pcm.size() / WHISPER_SAMPLE_RATE, params.target_rtf);
+
+    whisper_full_params wparams = make_whisper_params(params.n_threads);
+    if (params.fit_audio_ctx) {
+        wparams.audio_ctx = whisper_audio_ctx_for(pcm.size());
+    }
+
+    SttCalibration best;
+    if (!calibrate_stt(models, calibration_thread_counts(), pcm, CALIBRATION_TEXT,
+                       make_whisper_context_params(), wparams, params.target_rtf, best)) {
+        fprintf(stderr, "Error: Calibration failed\n");
+        return 1;
+    }
+
+    fprintf(stderr, "\nSelected %s with %d threads (RTF %.3f, WER %.1f%%)\n",
+            best.model.c_str(), best.n_threads, best.rtf, 100.0 * best.wer);
+
+    if (!save_stt_calibration(params.calibration_file, cpu, best)) {
+        return 1;
+    }
+    fprintf(stderr, "Saved to %s\n", params.calibration_file.c_str());
+
+    return 0;
+}
+
 int main(int argc, char** argv) {
     voice_chat_params params;
 
@@ -197,6 +544,29 @@ int main(int argc, char** argv) {
         return 1;
     }
 
+    if (params.calibrate) {
+        ggml_backend_load_all();
+        return run_calibration(params);
+    }
+
+    // Use the model and thread count calibrated for this CPU, unless given
+    // on the command line
+    SttCalibration calibration;
+    if (load_stt_calibration(params.calibration_file, cpu_signature(), calibration)) {
+        if (params.whisper_model.empty() || params.whisper_model == calibration.model) {
+            params.whisper_model = calibration.model;
+            if (!params.n_threads_set) {
+                params.n_threads = calibration.n_threads;
+            }
+            fprintf(stderr, "Using calibration from %s: %s, %d threads\n",
+                    params.calibration_file.c_str(), params.whisper_model.c_str(), params.n_threads);
+        }
+    }
+    if (params.whisper_model.empty()) {
+        fprintf(stderr, "Error: Whisper model path required (-wm), or run --calibrate first\n");
+        return 1;
+    }
+
     // Load API key from config file or environment
     std::string api_key = load_api_key();
     if (api_key.empty()) {
@@ -211,28 +581,68 @@ int main(int argc, char** argv) {
 
     fprintf(stderr, "Initializing voice chat...\n");
 
+    // Split the cores between whisper and piper so they don't oversubscribe
+    // the CPU when one reply is spoken while the next question is transcribed
+    ResourceManager resources;
+    const bool partition = !params.stt_cores.empty() || !params.tts_cores.empty() || params.pin_threads;
+    if (partition) {
+        if (!resources.init(params.stt_cores, params.tts_cores, params.pin_threads)) {
+            return 1;
+        }
+        fprintf(stderr, "%s", resources.describe().c_str());
+
+        const int n_threads = resources.stt_threads_per_worker(params.n_threads, params.stt_workers);
+        if (n_threads != params.n_threads) {
+            fprintf(stderr, "Whisper threads capped at %d per worker (%d STT cores, %d workers)\n",
+                    n_threads, resources.stage(Stage::Stt).n_threads, params.stt_workers);
+            params.n_threads = n_threads;
+        }
+
+        // Synthesis runs here; ORT's threads are created from this thread
+        resources.pin_current_thread(Stage::Tts);
+    }
+
     // Initialize ggml backends
     ggml_backend_load_all();
 
     // Initialize Whisper
     fprintf(stderr, "Loading whisper model: %s\n", params.whisper_model.c_str());
-    whisper_context_params cparams = whisper_context_default_params();
-    cparams.use_gpu = true;
-    cparams.flash_attn = true;
+    const whisper_context_params cparams = make_whisper_context_params();
 
-    whisper_context* ctx = whisper_init_from_file_with_params(params.whisper_model.c_str(), cparams);
-    if (!ctx) {
+    // The STT worker owns the model and runs all inference
+    SttWorker stt;
+    if (partition) {
+        stt.set_thread_start([&resources]() {
+            resources.pin_current_thread(Stage::Stt);
+        });
+    }
+    if (!stt.init(params.whisper_model, cparams, params.stt_workers)) {
         fprintf(stderr, "Error: Failed to load whisper model\n");
         return 1;
     }
+    whisper_context* ctx = stt.context();
 
     // Initialize Piper
     fprintf(stderr, "Loading piper model: %s\n", params.piper_model.c_str());
     const char* piper_cfg = params.piper_config.empty() ? nullptr : params.piper_config.c_str();
-    piper_synthesizer* synth = piper_create(params.piper_model.c_str(), piper_cfg, params.espeak_data.c_str());
+    piper_create_options create_opts = piper_default_create_options();
+    const std::string tts_affinities = resources.tts_thread_affinities();
+    if (partition) {
+        create_opts.intra_op_threads = resources.stage(Stage::Tts).n_threads;
+        create_opts.allow_spinning = false;  // leave the cores to whisper between sentences
+        create_opts.intra_op_thread_affinities = tts_affinities.c_str();
+    }
+    piper_synthesizer* synth = piper_create_with_options(params.piper_model.c_str(), piper_cfg,
+                                                         params.espeak_data.c_str(), &create_opts);
     if (!synth) {
         fprintf(stderr, "Error: Failed to create piper synthesizer\n");
-        whisper_free(ctx);
+        return 1;
+    }
+
+    // Control phrases are spotted before whisper runs
+    KeywordSpotter spotter(params.kws_threshold);
+    if (params.kws && !load_keyword_commands(params.kws_commands, synth, spotter)) {
+        piper_free(synth);
         return 1;
     }
 
@@ -240,38 +650,53 @@ int main(int argc, char** argv) {
     // Create NPC with full config
     NPCConfig npcConfig = createGuardNPC();
     NPCChat npc(api_key, npcConfig);
+    if (!params.llm_url.empty() || !params.ca_bundle.empty()) {
+        npc.setEndpoint(params.llm_url.empty() ? DEFAULT_CHAT_URL : params.llm_url, params.ca_bundle);
+        fprintf(stderr, "LLM endpoint: %s\n", params.llm_url.empty() ? DEFAULT_CHAT_URL : params.llm_url.c_str());
+    }
+
+    // Keep requests (and LLM latency) from growing with the conversation
+    NPCHistoryPolicy history_policy;
+    history_policy.maxTurns = std::max(params.history_turns, 0);
+    history_policy.maxTokens = std::max(params.history_tokens, 0);
+    history_policy.summarize = params.summarize_history;
+    npc.setHistoryPolicy(history_policy);
+    npc.setPromptCaching(params.prompt_cache);
 
     // Initialize audio capture
     AudioCapture capture(params.length_ms);
-    if (!capture.init(params.capture_id, WHISPER_SAMPLE_RATE)) {
+    bool capture_ok = false;
+    if (!params.input_file.empty()) {
+        fprintf(stderr, "Replaying %s at %.1fx\n", params.input_file.c_str(), params.input_speed);
+        capture_ok = capture.init(std::unique_ptr<AudioSource>(new WavFileAudioSource(params.input_file, params.input_speed)), WHISPER_SAMPLE_RATE);
+    } else {
+        capture_ok = capture.init(params.capture_id, WHISPER_SAMPLE_RATE);
+    }
+    if (!capture_ok) {
         fprintf(stderr, "Error: Failed to initialize audio capture\n");
         piper_free(synth);
-        whisper_free(ctx);
         return 1;
     }
 
     // Initialize audio playback
-    AudioPlayback playback;
+    std::unique_ptr<AudioSink> playback;
+    if (!params.output_file.empty()) {
+        playback.reset(new WavFileAudioSink(params.output_file));
+    } else if (params.null_output) {
+        playback.reset(new NullAudioSink());
+    } else {
+        playback.reset(new AudioPlayback());
+    }
     piper_synthesize_options piper_opts = piper_default_synthesize_options(synth);
     // Get sample rate from a test synthesis
-    if (!playback.init(22050)) {  // Default piper sample rate
+    if (!playback->init(22050)) {  // Default piper sample rate
         fprintf(stderr, "Error: Failed to initialize audio playback\n");
         piper_free(synth);
-        whisper_free(ctx);
         return 1;
     }
 
     // Set up whisper parameters
-    whisper_full_params wparams = whisper_full_default_params(WHISPER_SAMPLING_GREEDY);
-    wparams.print_progress = false;
-    wparams.print_special = false;
-    wparams.print_realtime = false;
-    wparams.print_timestamps = false;
-    wparams.translate = false;
-    wparams.single_segment = true;
-    wparams.no_context = true;
-    wparams.language = "en";
-    wparams.n_threads = params.n_threads;
+    const whisper_full_params wparams = make_whisper_params(params.n_threads);
 
     // Start capturing
     capture.resume();
@@ -282,97 +707,406 @@ int main(int argc, char** argv) {
     fprintf(stderr, "\n");
 
     std::vector<float> pcmf32;
-    std::vector<float> pcmf32_vad;
+    std::vector<float> pcmf32_new;
+
+    EndpointerParams ep_params;
+    ep_params.freq_thold = params.freq_thold;
+    ep_params.hangover_ms = params.vad_hangover_ms;
+    ep_params.short_hangover_ms = std::min(params.vad_short_hangover_ms, params.vad_hangover_ms);
+    ep_params.max_speech_ms = params.length_ms;  // older audio is gone from the capture buffer
+    Endpointer endpointer(WHISPER_SAMPLE_RATE, ep_params);
+
+    StreamingTranscriber stream_stt(ctx, wparams, params.step_ms, params.length_ms);
+    stream_stt.set_fit_audio_ctx(params.fit_audio_ctx);
+
+    const uint64_t vad_margin = (uint64_t)params.vad_margin_ms * WHISPER_SAMPLE_RATE / 1000;
+
+    // Log-mel frames of the current utterance, computed as audio arrives
+    MelStream mel_stream(whisper_model_n_mels(ctx));
+    std::vector<float> mel;
+    const bool use_mel_stream = params.incremental_mel && !params.stream;
+    bool mel_active = false;
+    uint64_t mel_pos = 0;  // sample position of the first sample in mel_stream
+
+    // Transcriptions in flight on the STT worker
+    std::future<SttResult> stt_final;    // end of utterance
+    std::future<SttResult> stt_partial;  // streaming step
+    bool stream_active = false;
+    uint64_t stream_next_step = 0;
+    const uint64_t step_samples = (uint64_t)params.step_ms * WHISPER_SAMPLE_RATE / 1000;
+
+    // LLM request on a partial transcript; replaced ones are cancelled and
+    // kept until their thread returns
+    std::unique_ptr<SpeculativeReply> speculation;
+    std::vector<std::unique_ptr<SpeculativeReply>> cancelled;
+    std::string last_partial;
+
+    std::string last_response;  // for the "repeat" keyword
+
+    // Sentences are synthesized on the TTS thread while the reply streams in
+    TtsPipeline tts(synth, piper_opts, playback.get());
+    SentenceAssembler sentences([&tts](const std::string& sentence) {
+        tts.say(sentence);
+    });
+
+    // Wait until the queued reply has been spoken
+    auto finish_speaking = [&](std::chrono::steady_clock::time_point t_start, const char* since) {
+        sentences.flush();
+        tts.finish();
+        playback->waitComplete();
+
+        const auto t_output = playback->outputStartTime();
+        if (t_output >= t_start) {
+            fprintf(stderr, "[first audio %lld ms after %s]\n",
+                    (long long)std::chrono::duration_cast<std::chrono::milliseconds>(t_output - t_start).count(), since);
+        }
+    };
+
+    auto speak = [&](const std::string& text) {
+        const auto t_synth = std::chrono::steady_clock::now();
+        sentences.push(text);
+        finish_speaking(t_synth, "synthesis start");
+    };
 
     bool is_running = true;
-    bool was_speaking = false;
-    int silence_count = 0;
-    const int silence_threshold = 3;  // Number of silent iterations before processing
+
+    // Sample clock positions (total samples captured)
+    uint64_t audio_pos = 0;
+    uint64_t vad_pos = 0;
 
     while (is_running) {
         is_running = sdl_poll_events();
         if (!is_running) break;
 
-        // Get recent audio for VAD check
-        capture.get(2000, pcmf32_vad);
+        // Sleep until the capture callback delivers the next frame; the
+        // timeout only exists so SDL events and transcripts keep being polled
+        capture.wait_for_audio(audio_pos, 50);
 
-        if (pcmf32_vad.size() < 1600) {  // Need at least 100ms at 16kHz
-            std::this_thread::sleep_for(std::chrono::milliseconds(100));
-            continue;
-        }
+        // Checked before reading so the final frames are always processed
+        const bool input_done = capture.finished();
 
-        // Check for voice activity
-        bool is_speaking = !vad_simple(pcmf32_vad, WHISPER_SAMPLE_RATE, 1000, params.vad_thold, params.freq_thold, false);
+        // Run the endpointer over everything captured since the last pass
+        const uint64_t new_pos = capture.get_since(vad_pos, pcmf32_new);
+        vad_pos = new_pos + pcmf32_new.size();
 
-        if (is_speaking) {
-            was_speaking = true;
-            silence_count = 0;
-        } else if (was_speaking) {
-            silence_count++;
+        const EndpointEvent event = endpointer.process(new_pos, pcmf32_new.data(), pcmf32_new.size());
 
-            // User stopped speaking, process the audio
-            if (silence_count >= silence_threshold) {
-                was_speaking = false;
-                silence_count = 0;
+        cancelled.erase(std::remove_if(cancelled.begin(), cancelled.end(), [](const std::unique_ptr<SpeculativeReply>& s) {
+            return s->done.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+        }), cancelled.end());
 
-                // Get the full audio buffer
-                capture.get(params.length_ms, pcmf32);
+        // A new utterance only starts once the previous one is transcribed
+        const bool stt_idle = !stt_final.valid();
 
-                if (pcmf32.size() < 1600) {
-                    continue;
-                }
+        if (params.stream) {
+            if (event == EndpointEvent::SpeechStart && stt_idle) {
+                const uint64_t start = endpointer.speech_start();
+                const uint64_t begin = start > vad_margin ? start - vad_margin : 0;
+
+                std::future<SttResult> started;
+                stream_active = stt.submit([&stream_stt, begin](whisper_context*, whisper_state*) {
+                    stream_stt.begin(begin);
+                    return SttResult{true, ""};
+                }, started);
+                stream_next_step = begin + step_samples;
+            }
 
-                // Run whisper inference
-                if (whisper_full(ctx, wparams, pcmf32.data(), pcmf32.size()) != 0) {
-                    fprintf(stderr, "Whisper inference failed\n");
-                    continue;
+            if (stt_partial.valid() && stt_partial.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+                const SttResult partial = stt_partial.get();
+                if (partial.ok && stream_active) {
+                    endpointer.set_sentence_end_hint(ends_sentence(partial.text));
+                    fprintf(stderr, "[partial] %s\n", partial.text.c_str());
+
+                    // A partial that ends a sentence, or didn't change over a
+                    // step, is likely what the player will end up saying
+                    const std::string text = clean_transcription(partial.text);
+                    const bool confident = !text.empty() && (ends_sentence(text) || text == last_partial);
+                    last_partial = text;
+
+                    if (params.speculate && confident &&
+                        (!speculation || transcript_similarity(speculation->prompt, text) < params.speculate_similarity)) {
+                        if (speculation) {
+                            speculation->cancel = true;
+                            cancelled.push_back(std::move(speculation));
+                        }
+                        fprintf(stderr, "[speculative request] %s\n", text.c_str());
+                        speculation = start_speculation(npc, text);
+                    }
                 }
+            }
+
+            // Decode the growing utterance every step_ms while speech
+            // continues, one step at a time
+            if (stream_active && event == EndpointEvent::None && endpointer.in_speech() &&
+                !stt_partial.valid() && vad_pos >= stream_next_step) {
+                stream_next_step = vad_pos + step_samples;
 
-                // Get transcription
-                std::string transcription;
-                const int n_segments = whisper_full_n_segments(ctx);
-                for (int i = 0; i < n_segments; i++) {
-                    const char* text = whisper_full_get_segment_text(ctx, i);
-                    transcription += text;
+                stt.submit([&stream_stt, &capture](whisper_context*, whisper_state* state) {
+                    std::vector<float> pcm;
+                    const uint64_t pos = capture.get_since(stream_stt.committed_pos(), pcm);
+
+                    SttResult result;
+                    result.ok = stream_stt.step(state, pos, pcm.data(), pcm.size());
+                    result.text = stream_stt.partial_text();
+                    return result;
+                }, stt_partial);
+            }
+        }
+
+        if (use_mel_stream) {
+            if (event == EndpointEvent::SpeechStart && stt_idle) {
+                // Catch up on the audio from before the start was confirmed
+                const uint64_t start = endpointer.speech_start();
+                mel_stream.reset();
+                mel_pos = capture.get_since(start > vad_margin ? start - vad_margin : 0, pcmf32);
+                mel_active = mel_pos < vad_pos;
+                if (mel_active) {
+                    mel_stream.push(pcmf32.data(), (size_t)std::min<uint64_t>(vad_pos - mel_pos, pcmf32.size()));
+                }
+            } else if (mel_active) {
+                if (new_pos == mel_pos + mel_stream.n_samples()) {
+                    mel_stream.push(pcmf32_new.data(), pcmf32_new.size());
+                } else {
+                    mel_active = false;  // capture overran, fall back to whisper's own front-end
                 }
+            }
+        }
+
+        // Short utterances are first checked against the control phrases
+        std::string command;
+        if (event == EndpointEvent::SpeechEnd && stt_idle && !spotter.empty()) {
+            const uint64_t start = endpointer.speech_start();
+            const uint64_t seg_begin = start > vad_margin ? start - vad_margin : 0;
+            const uint64_t seg_end = endpointer.speech_end() + vad_margin;
 
-                transcription = clean_transcription(transcription);
+            if (seg_end - seg_begin <= spotter.max_samples()) {
+                size_t n_samples = 0;
+                const float* samples = capture.get_range(seg_begin, seg_end, n_samples, pcmf32);
+
+                float distance = 0.0f;
+                command = spotter.match(samples, n_samples, &distance);
+                fprintf(stderr, "[keyword: %s (distance %.2f)]\n", command.empty() ? "none" : command.c_str(), distance);
+            }
+        }
 
-                if (transcription.empty()) {
-                    continue;
+        // User stopped speaking, hand the audio to the STT worker
+        if (event == EndpointEvent::SpeechEnd && stt_idle && command.empty()) {
+            fprintf(stderr, "[endpoint after %d ms of silence (avg %.0f ms), noise floor %.1f dB]\n",
+                    endpointer.last_latency_ms(), endpointer.mean_latency_ms(), endpointer.noise_floor_db());
+
+            if (stream_active) {
+                stream_active = false;
+
+                // Most of the utterance is committed already, only the tail is left
+                const uint64_t end = vad_pos;
+                stt.submit([&stream_stt, &capture, end](whisper_context*, whisper_state* state) {
+                    std::vector<float> pcm;
+                    const uint64_t pos = capture.get_since(stream_stt.committed_pos(), pcm);
+                    pcm.resize((size_t)std::min<uint64_t>(end > pos ? end - pos : 0, pcm.size()));
+
+                    SttResult result;
+                    result.ok = stream_stt.finish(state, pos, pcm.data(), pcm.size(), result.text);
+                    fprintf(stderr, "[streaming: %d decodes, final tail %.2f s]\n",
+                            stream_stt.decode_count(), (float)pcm.size() / WHISPER_SAMPLE_RATE);
+                    return result;
+                }, stt_final);
+            } else {
+                // Only the detected speech plus a margin goes to whisper: leading
+                // silence and the hangover would just be encoded for nothing
+                const uint64_t start = endpointer.speech_start();
+                const uint64_t seg_begin = start > vad_margin ? start - vad_margin : 0;
+                const uint64_t seg_end = endpointer.speech_end() + vad_margin;
+
+                const bool from_mel = mel_active;
+                mel_active = false;
+
+                size_t n_samples = 0;
+                const float* samples = nullptr;
+                if (from_mel) {
+                    n_samples = (size_t)(std::min(seg_end, mel_pos + mel_stream.n_samples()) - std::min(seg_end, mel_pos));
+                } else {
+                    samples = capture.get_range(seg_begin, seg_end, n_samples, pcmf32);
                 }
 
-                fprintf(stderr, "You: %s\n", transcription.c_str());
+                whisper_full_params seg_params = wparams;
+                if (params.fit_audio_ctx) {
+                    seg_params.audio_ctx = whisper_audio_ctx_for(std::max(n_samples, STT_MIN_SAMPLES));
+                }
 
-                // Get response from Claude Haiku
-                std::string response = npc.chat(transcription);
-                fprintf(stderr, "%s: %s\n", npc.getName().c_str(), response.c_str());
+                if (n_samples < 1600) {
+                    // Too short to be a question
+                } else if (from_mel) {
+                    // Only the last frames and the normalization are left; pad
+                    // with silence frames over everything the encoder reads
+                    const int n_ctx = seg_params.audio_ctx > 0 ? seg_params.audio_ctx : whisper_n_audio_ctx(ctx);
+                    const int min_len = std::max(2 * n_ctx, (int)(STT_MIN_SAMPLES / MelStream::HOP));
+                    const int n_len = mel_stream.finish(n_samples, min_len, mel);
+                    const int n_mel = mel_stream.n_mel();
 
-                // Synthesize and play response
-                if (piper_synthesize_start(synth, response.c_str(), &piper_opts) == PIPER_OK) {
-                    piper_audio_chunk chunk;
-                    while (piper_synthesize_next(synth, &chunk) == PIPER_OK) {
-                        playback.queue(chunk.samples, chunk.num_samples);
+                    auto data = std::make_shared<std::vector<float>>(std::move(mel));
+                    stt.submit([data, n_len, n_mel, seg_params](whisper_context* ctx, whisper_state* state) {
+                        SttResult result;
+                        result.ok = whisper_set_mel_with_state(ctx, state, data->data(), n_len, n_mel) == 0 &&
+                                    whisper_full_with_state(ctx, state, seg_params, nullptr, 0) == 0;
+                        if (result.ok) {
+                            result.text = whisper_state_text(state);
+                        }
+                        return result;
+                    }, stt_final);
+                } else {
+                    auto data = std::make_shared<std::vector<float>>(samples, samples + n_samples);
+                    // whisper ignores input under 1 s, so pad short questions
+                    if (data->size() < STT_MIN_SAMPLES) {
+                        data->resize(STT_MIN_SAMPLES, 0.0f);
                     }
-                    playback.waitComplete();
+
+                    stt.submit([data, seg_params](whisper_context* ctx, whisper_state* state) {
+                        SttResult result;
+                        result.ok = whisper_full_with_state(ctx, state, seg_params, data->data(), (int)data->size()) == 0;
+                        if (result.ok) {
+                            result.text = whisper_state_text(state);
+                        }
+                        return result;
+                    }, stt_final);
                 }
+            }
+        }
+
+        if (!command.empty()) {
+            // Whatever was started for this utterance is not needed. A
+            // streaming step still running is dropped too, or its partial
+            // would be taken for the next utterance's (the worker runs it
+            // before that utterance begins; the future doesn't block).
+            stream_active = false;
+            stt_partial = std::future<SttResult>();
+            mel_active = false;
+            last_partial.clear();
+            if (speculation) {
+                speculation->cancel = true;
+                cancelled.push_back(std::move(speculation));
+            }
 
-                // Clear the audio buffer after processing
+            if (command == "quit") {
+                fprintf(stderr, "%s: Farewell.\n", npc.getName().c_str());
+                break;
+            } else if (command == "repeat" && !last_response.empty()) {
+                fprintf(stderr, "%s: %s\n", npc.getName().c_str(), last_response.c_str());
+                capture.pause();
+                speak(last_response);
                 capture.clear();
+                capture.resume();
+            } else if (command == "reset") {
+                npc.clearHistory();
+                last_response.clear();
+                fprintf(stderr, "[conversation reset]\n");
+            }
+            continue;
+        }
+
+        if (!stt_final.valid()) {
+            if (input_done && !endpointer.in_speech()) {
+                fprintf(stderr, "Input finished\n");
+                break;
+            }
+            continue;
+        }
+
+        if (stt_final.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+            continue;
+        }
+
+        const SttResult result = stt_final.get();
+        if (!result.ok) {
+            fprintf(stderr, "Whisper inference failed\n");
+        }
+
+        const std::string transcription = clean_transcription(result.text);
+        last_partial.clear();
 
-                fprintf(stderr, "\n[Listening...]\n");
+        // Keep the speculative reply only if the player ended up saying the
+        // same thing; otherwise it answers the wrong question
+        std::unique_ptr<SpeculativeReply> spec = std::move(speculation);
+        if (spec && (transcription.empty() ||
+                     transcript_similarity(spec->prompt, transcription) < params.speculate_similarity)) {
+            if (!transcription.empty()) {
+                fprintf(stderr, "[speculative reply discarded (similarity %.2f)]\n",
+                        transcript_similarity(spec->prompt, transcription));
             }
+            spec->cancel = true;
+            cancelled.push_back(std::move(spec));
         }
 
-        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        if (!transcription.empty()) {
+            fprintf(stderr, "You: %s\n", transcription.c_str());
+
+            // Hold the input while we respond: the microphone would only pick
+            // up the NPC, and replayed input must not run ahead
+            capture.pause();
+
+            // Get response from Claude Haiku
+            const auto t_request = std::chrono::steady_clock::now();
+            std::string response;
+            if (spec && spec->done.get()) {
+                fprintf(stderr, "[speculative reply used]\n");
+                response = spec->response;
+                npc.commitTurn(transcription, response);
+                sentences.push(response);
+            } else {
+                // Streamed: each sentence is spoken as soon as it is complete,
+                // while the model is still writing the next one
+                bool first_token = true;
+                std::string streamed;
+                response = npc.chatStream(transcription, [&](const std::string& token) {
+                    if (first_token) {
+                        first_token = false;
+                        fprintf(stderr, "[first token %lld ms after request]\n",
+                                (long long)std::chrono::duration_cast<std::chrono::milliseconds>(
+                                    std::chrono::steady_clock::now() - t_request).count());
+                    }
+                    streamed += token;
+                    sentences.push(token);
+                    return true;
+                });
+
+                // The request failed (the reply is the fallback line). If it
+                // broke off mid-reply, cut the partial answer short so the
+                // fallback is what the player hears last and what gets repeated.
+                if (response != streamed) {
+                    if (!first_token) {
+                        sentences.reset();
+                        tts.abort();
+                        playback->clear();
+                    }
+                    sentences.push(response);
+                }
+            }
+            fprintf(stderr, "%s: %s\n", npc.getName().c_str(), response.c_str());
+            last_response = response;
+
+            finish_speaking(t_request, "request");
+
+            fprintf(stderr, "\n[Listening...]\n");
+
+            // Drop the answered utterance before listening again; clearing
+            // after resume() could discard the first frames of the next one
+            capture.clear();
+            capture.resume();
+        }
     }
 
     fprintf(stderr, "\nShutting down...\n");
 
     capture.pause();
-    playback.clear();
+    playback->clear();
+    for (auto& s : cancelled) {
+        s->cancel = true;
+    }
+    if (speculation) {
+        speculation->cancel = true;
+    }
+    stt.stop();
+    tts.stop();
     piper_free(synth);
-    whisper_free(ctx);
 
     return 0;
 }
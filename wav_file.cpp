@@ -0,0 +1,191 @@
+#include "wav_file.h"
+
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+
+static uint16_t read_u16(const uint8_t* p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t read_u32(const uint8_t* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void put_u16(std::ofstream& out, uint16_t v) {
+    const uint8_t b[2] = {(uint8_t)(v & 0xff), (uint8_t)(v >> 8)};
+    out.write((const char*)b, sizeof(b));
+}
+
+static void put_u32(std::ofstream& out, uint32_t v) {
+    const uint8_t b[4] = {(uint8_t)(v & 0xff), (uint8_t)((v >> 8) & 0xff), (uint8_t)((v >> 16) & 0xff), (uint8_t)(v >> 24)};
+    out.write((const char*)b, sizeof(b));
+}
+
+bool read_wav(const std::string& path, std::vector<float>& samples, int& sample_rate) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        fprintf(stderr, "%s: failed to open '%s'\n", __func__, path.c_str());
+        return false;
+    }
+
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    if (data.size() < 12 || memcmp(data.data(), "RIFF", 4) != 0 || memcmp(data.data() + 8, "WAVE", 4) != 0) {
+        fprintf(stderr, "%s: '%s' is not a WAV file\n", __func__, path.c_str());
+        return false;
+    }
+
+    uint16_t format = 0;
+    uint16_t channels = 0;
+    uint16_t bits = 0;
+    uint32_t rate = 0;
+    const uint8_t* pcm = nullptr;
+    size_t pcm_bytes = 0;
+
+    // Walk the chunk list; fmt must come before data
+    size_t off = 12;
+    while (off + 8 <= data.size()) {
+        const uint8_t* chunk = data.data() + off;
+        const uint32_t chunk_size = read_u32(chunk + 4);
+        const size_t body = off + 8;
+
+        if (memcmp(chunk, "fmt ", 4) == 0 && chunk_size >= 16 && body + 16 <= data.size()) {
+            format = read_u16(chunk + 8);
+            channels = read_u16(chunk + 10);
+            rate = read_u32(chunk + 12);
+            bits = read_u16(chunk + 22);
+
+            // WAVE_FORMAT_EXTENSIBLE: the real format is the first 2 bytes of the subformat GUID
+            if (format == 0xFFFE && chunk_size >= 40 && body + 40 <= data.size()) {
+                format = read_u16(chunk + 8 + 24);
+            }
+        } else if (memcmp(chunk, "data", 4) == 0) {
+            pcm = data.data() + body;
+            pcm_bytes = std::min<size_t>(chunk_size, data.size() - body);
+            break;
+        }
+
+        off = body + chunk_size + (chunk_size & 1);
+    }
+
+    if (!pcm || channels == 0 || rate == 0) {
+        fprintf(stderr, "%s: '%s' has no usable fmt/data chunks\n", __func__, path.c_str());
+        return false;
+    }
+
+    const bool is_float = format == 3 && bits == 32;
+    const bool is_pcm = format == 1 && (bits == 8 || bits == 16 || bits == 24 || bits == 32);
+    if (!is_float && !is_pcm) {
+        fprintf(stderr, "%s: '%s' has unsupported format %d (%d bits)\n", __func__, path.c_str(), format, bits);
+        return false;
+    }
+
+    const size_t bytes_per_sample = bits / 8;
+    const size_t n_frames = pcm_bytes / (bytes_per_sample * channels);
+
+    samples.resize(n_frames);
+    for (size_t i = 0; i < n_frames; i++) {
+        float sum = 0.0f;
+        for (size_t c = 0; c < channels; c++) {
+            const uint8_t* p = pcm + (i * channels + c) * bytes_per_sample;
+            float v = 0.0f;
+            if (is_float) {
+                uint32_t u = read_u32(p);
+                memcpy(&v, &u, sizeof(v));
+            } else if (bits == 8) {
+                v = ((int)p[0] - 128) / 128.0f;
+            } else if (bits == 16) {
+                v = (int16_t)read_u16(p) / 32768.0f;
+            } else if (bits == 24) {
+                int32_t s = (int32_t)((uint32_t)p[0] << 8 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 24) >> 8;
+                v = s / 8388608.0f;
+            } else {
+                v = (int32_t)read_u32(p) / 2147483648.0f;
+            }
+            sum += v;
+        }
+        samples[i] = sum / channels;
+    }
+
+    sample_rate = (int)rate;
+    return true;
+}
+
+void resample_linear(const std::vector<float>& in, int rate_in, std::vector<float>& out, int rate_out) {
+    if (rate_in == rate_out || in.empty()) {
+        out = in;
+        return;
+    }
+
+    const size_t n_out = (size_t)((uint64_t)in.size() * rate_out / rate_in);
+    out.resize(n_out);
+
+    const double step = (double)rate_in / rate_out;
+    for (size_t i = 0; i < n_out; i++) {
+        const double t = i * step;
+        const size_t i0 = (size_t)t;
+        const size_t i1 = std::min(i0 + 1, in.size() - 1);
+        const float frac = (float)(t - i0);
+        out[i] = in[i0] + (in[i1] - in[i0]) * frac;
+    }
+}
+
+WavWriter::~WavWriter() {
+    close();
+}
+
+bool WavWriter::open(const std::string& path, int sample_rate) {
+    close();
+
+    m_file.open(path, std::ios::binary | std::ios::trunc);
+    if (!m_file.is_open()) {
+        fprintf(stderr, "%s: failed to open '%s' for writing\n", __func__, path.c_str());
+        return false;
+    }
+
+    m_sample_rate = sample_rate;
+    m_n_samples = 0;
+    write_header();
+
+    return true;
+}
+
+void WavWriter::write(const float* samples, size_t n_samples) {
+    if (!m_file.is_open()) {
+        return;
+    }
+
+    m_file.write((const char*)samples, n_samples * sizeof(float));
+    m_n_samples += n_samples;
+}
+
+void WavWriter::close() {
+    if (!m_file.is_open()) {
+        return;
+    }
+
+    m_file.seekp(0);
+    write_header();
+    m_file.close();
+}
+
+void WavWriter::write_header() {
+    const uint32_t data_bytes = (uint32_t)std::min<uint64_t>(m_n_samples * sizeof(float), UINT32_MAX - 36);
+
+    m_file.write("RIFF", 4);
+    put_u32(m_file, 36 + data_bytes);
+    m_file.write("WAVEfmt ", 8);
+    put_u32(m_file, 16);
+    put_u16(m_file, 3);  // IEEE float
+    put_u16(m_file, 1);  // mono
+    put_u32(m_file, m_sample_rate);
+    put_u32(m_file, m_sample_rate * sizeof(float));
+    put_u16(m_file, sizeof(float));
+    put_u16(m_file, 32);
+    m_file.write("data", 4);
+    put_u32(m_file, data_bytes);
+}
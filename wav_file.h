@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// Read a WAV file as mono float samples in [-1, 1].
+// Supports 8/16/24/32-bit PCM and 32-bit float; channels are averaged.
+bool read_wav(const std::string& path, std::vector<float>& samples, int& sample_rate);
+
+// Linear-interpolation resampling (adequate for speech into whisper)
+void resample_linear(const std::vector<float>& in, int rate_in, std::vector<float>& out, int rate_out);
+
+// Streams mono float samples to a 32-bit float WAV file.
+// The header sizes are patched in close().
+class WavWriter {
+public:
+    ~WavWriter();
+
+    bool open(const std::string& path, int sample_rate);
+    void write(const float* samples, size_t n_samples);
+    void close();
+
+    bool is_open() const { return m_file.is_open(); }
+
+private:
+    void write_header();
+
+    std::ofstream m_file;
+    int m_sample_rate = 0;
+    uint64_t m_n_samples = 0;
+};